@@ -23,13 +23,6 @@ for i in "${states[@]}"; do
 done
 
 echo "all data present"
-IFS=$'\n'
 
-for i in "${states[@]}"; do
-    if [[ "$(echo "${i}" | cut -c 1)" == [u-z] ]]; then
-        echo "serializing ${i}..."
-        build/serialize.sh "$i"
-    fi
-    # printf "\nbuilding $(echo "$i" | cut -d ' ' -f 2 | rev | cut -d '/' -f2 | rev)\n\n"
-    # eval "$i"
-done
+# serialize every state in build_data.list, several at a time
+exec bin/serialize_all "$@"
@@ -18,8 +18,10 @@
 
 #include <map>
 #include <array>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <random>
 #include <sstream>
 #include <fstream>
@@ -27,11 +29,14 @@
 #include <cmath>
 #include <iostream>
 #include <unordered_map>
+#include <memory>
 
 // external library includes for json, maps, and serialization
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/point_xy.hpp>
 #include <boost/geometry/geometries/polygon.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/geometry/index/rtree.hpp>
 #include <boost/filesystem.hpp>
 
 #include "../lib/ordered-map/include/tsl/ordered_map.h"
@@ -66,9 +71,14 @@ namespace hte {
     class Precinct;
     class PrecinctGroup;
     class State;
+    class CensusBlocks;
+    class Topology;
+    class CompactCoordinates;
+    class StateView;
     enum class PoliticalParty;
     enum class IdType;
     class DataParser;
+    class MappedFile;
 
     // graphics structures
     class Outline;
@@ -92,6 +102,9 @@ namespace hte {
     // external geometry library typedefs (Boost.Geometry and Miniball)
     typedef boost::geometry::model::d2::point_xy<long long int>                          BoostPoint2d;
     typedef boost::geometry::model::polygon<BoostPoint2d>                                BoostPolygon;
+    typedef boost::geometry::model::box<BoostPoint2d>                                    BoostBox;
+    typedef boost::geometry::index::rtree<std::pair<BoostBox, int>,
+                                          boost::geometry::index::rstar<16> >            BoundingBoxIndex;  //!< Spatial index of boxes tagged with an index
     typedef std::vector<double>::const_iterator                                          CoordIterator;
     typedef std::vector<std::vector<double> >::const_iterator                            PointIterator; 
     typedef Miniball::Miniball <Miniball::CoordAccessor<PointIterator, CoordIterator> >  MB;
@@ -107,6 +120,14 @@ namespace hte {
         XOR
     };
 
+    /**
+     * \brief Ways of finding which precincts border each other
+     */
+    enum class AdjacencyMethod {
+        CLIP,      //!< Union the shapes of precincts with overlapping bounds
+        SEGMENTS   //!< Match identical boundary segments, recording border lengths
+    };
+
     /**
      * A 2-dimensional cartesian point, consisting
      * of public x and y integer coordinates.
@@ -144,12 +165,12 @@ namespace hte {
     class LinearRing {
         public:
 
-            LinearRing() : centroid(NULL, NULL) {}
-            LinearRing(Point2dVec b) : centroid(NULL, NULL) {
+            LinearRing() : centroid(0, 0) {}
+            LinearRing(Point2dVec b) : centroid(0, 0) {
                 border = b;
             }
 
-            Point2d     centroid;    //!< The centroid (default NULL,NULL) of the ring
+            Point2d     centroid;    //!< The centroid (default 0,0) of the ring
             Point2dVec  border;   //!< A closed set of coordinates
 
             virtual double       getSignedArea();
@@ -251,16 +272,23 @@ namespace hte {
     std::vector<long> GetEquation(Segment s);
     Segment PointsToSegment(Point2d c1, Point2d c2);
 
-    bool GetBordering(Polygon, Polygon);
+    bool GetBordering(const Polygon&, const Polygon&);
     bool GetBoundOverlap(BoundingBox, BoundingBox);
     bool GetBoundInside(BoundingBox, BoundingBox);
     bool GetPointInRing(Point2d, LinearRing);
-    bool GetInside(LinearRing, LinearRing);
+    bool GetInside(const LinearRing&, const LinearRing&);
     bool GetInsideFirst(LinearRing s0, LinearRing s1);
     bool GetPointInCircle(Point2d center, double radius, Point2d point);
 
     double             GetDistance(Point2d c1, Point2d c2);
     double             GetDistance(Segment s);
+
+    // ring kernels behind `LinearRing`, vectorized with AVX2 where the cpu
+    // supports it unless `vectorize` is false. Both versions give identical results
+    double             GetShoelaceSum(const Point2dVec& ring, bool vectorize = true);  // twice the signed area
+    double             GetRingPerimeter(const Point2dVec& ring, bool vectorize = true);
+    BoundingBox        GetRingBoundingBox(const Point2dVec& ring, bool vectorize = true);
+    bool               HasVectorKernels();
     
     Polygon            GenerateGon(Point2d center, double radius, int nSides);
     MultiPolygon       GenerateExteriorBorder(PrecinctGroup pg);
@@ -268,6 +296,7 @@ namespace hte {
     Segment            CoordsToSegment(Point2d c1, Point2d c2);
     LinearRing         PathToRing(ClipperLib::Path path);
     BoostPolygon       RingToBoostPoly(LinearRing);
+    BoostBox           BoundingBoxToBoostBox(BoundingBox box);
     MultiPolygon       PathsToMultiPolygon(ClipperLib::Paths paths);
     ClipperLib::Path   RingToPath(LinearRing ring);
     ClipperLib::Paths  PolygonToPaths(Polygon shape);
@@ -282,7 +311,24 @@ namespace hte {
     enum class IdType {
         GEOID,
         ELECTIONID,
-        POPUID
+        POPUID,
+        BLOCKID,     //!< Census block id column, GEOID if not given
+        BLOCKPOPUID  //!< Census block population column, POPUID if not given
+    };
+
+
+    /**
+     * \brief Geometry derived from a precinct's shape
+     * 
+     * Computed once when a state is generated, so
+     * that it doesn't need to be recalculated
+     */
+    struct PrecinctAttributes {
+        Point2d      centroid;         //!< Centroid of the precinct's hull
+        double       area = 0;         //!< Signed area of the hull minus its holes
+        double       perimeter = 0;    //!< Perimeter of the hull and holes
+        BoundingBox  boundingBox;      //!< Bounding box of the hull
+        LinearRing   convexHull;       //!< Convex hull of the precinct's hull
     };
 
 
@@ -314,6 +360,30 @@ namespace hte {
             friend bool operator!= (const Precinct& p1, const Precinct& p2);
 
             std::map<PoliticalParty, int> voterData;  //!< Voter data in the form `{POLITICAL_PARTY, count}`
+
+            std::shared_ptr<const StateView> geometrySource;  //!< File the hull and holes are read from on first use, if not yet read
+            int geometryIndex = -1;                           //!< Index of the precinct in `geometrySource`
+            std::shared_ptr<const PrecinctAttributes> attributes;  //!< Stored derived geometry, used in place of the rings if set
+
+            /**
+             * \brief Reads the hull and holes from `geometrySource`, if
+             * the precinct was loaded without them
+             */
+            void loadGeometry();
+
+            /**
+             * \brief Gets the hull, reading a copy from `geometrySource`
+             * without keeping it if the precinct was loaded without its
+             * rings, so the mapping stays the only stored copy
+             */
+            LinearRing getHull() const;
+
+            // use stored attributes, or read the hull and holes before using them
+            double       getSignedArea();
+            double       getPerimeter();
+            SegmentVec   getSegments();
+            BoundingBox  getBoundingBox();
+            std::string  toJson();
     };
 
 
@@ -337,6 +407,7 @@ namespace hte {
             std::vector<Precinct> precincts;
 
             std::string  toJson();
+            void           loadGeometry();  // read the geometry of precincts loaded without it
             int            getPopulation();
             void           removePrecinct(Precinct);
             void           addPrecinct(Precinct);
@@ -397,6 +468,7 @@ namespace hte {
         public:
             tsl::ordered_map<int, Node> vertices;  //!< All nodes on the graph
             std::vector<Edge> edges;               //!< List of unique edges on the graph
+            std::map<Edge, double> borderLengths;  //!< Shared border length of each {low, high} edge, if known
 
             /**
              * \brief Get the induced subgraph from a list of node ids
@@ -432,6 +504,303 @@ namespace hte {
 
 
 
+    /**
+     * \brief Input files and header keys for generating a state
+     *
+     * Passed to `State::GenerateFromFile` to parse a state straight
+     * from the files on disk. The precinct and district geojson are
+     * streamed one feature at a time rather than read into a single
+     * document, so memory use doesn't grow with the input size.
+     */
+    class DataParser {
+        public:
+
+            DataParser(){}
+            DataParser(std::string precinctFile, std::string districtFile, std::map<PoliticalParty, std::string> electionHeaders, std::map<IdType, std::string> idHeaders)
+                : precinctFile(precinctFile), districtFile(districtFile), electionHeaders(electionHeaders), idHeaders(idHeaders) {}
+
+            DataParser(std::string precinctFile, std::string voterFile, std::string districtFile, std::map<PoliticalParty, std::string> electionHeaders, std::map<IdType, std::string> idHeaders)
+                : precinctFile(precinctFile), voterFile(voterFile), districtFile(districtFile), electionHeaders(electionHeaders), idHeaders(idHeaders) {}
+
+            std::string precinctFile;  //!< Path to the precinct geojson
+            std::string voterFile;     //!< Path to tab separated voter data, empty if votes are in the geojson
+            std::string districtFile;  //!< Path to the district geojson
+            std::string blockFile;     //!< Path to census block geojson, empty to generate without blocks
+
+            std::map<PoliticalParty, std::string> electionHeaders;  //!< Voter data column for each party
+            std::map<IdType, std::string> idHeaders;                //!< Id and population columns
+
+            AdjacencyMethod adjacency = AdjacencyMethod::CLIP;  //!< How bordering precincts are found
+            int threads = 0;  //!< Workers for finding bordering precincts, or 0 for one per core
+            double simplifyTolerance = 0;  //!< Tolerance for simplifying precinct borders, or 0 to keep every point
+            bool borderLengths = false;  //!< Record the shared border length of every edge, not only with SEGMENTS adjacency
+
+            //! Precincts with ids containing any of these are water or otherwise not real precincts, and are removed
+            std::vector<std::string> nonPrecinctIds = {
+                "9999", "WV", "ZZZZZ", "LAKE", "WWWWWW", "1808904150", "1812700460", "39095123ZZZ",
+                "39043043ACN", "39123123ZZZ", "39043043ZZZ", "39093093999", "39035007999", "3908500799", "3900700799"
+            };
+
+            /**
+             * \brief Version of the parser, stored in manifests. Increase
+             * it whenever a parsing change alters the states generated
+             */
+            static const int VERSION = 6;
+
+            /**
+             * \brief Describes everything that determines the state
+             * generated from this parser: the parser version, header
+             * keys and adjacency method, and a hash of each input file.
+             * 
+             * Saved next to a serialized state, an unchanged manifest
+             * means the state doesn't need to be generated again.
+             * \return The manifest as text
+             */
+            std::string getManifest() const;
+    };
+
+
+    /**
+     * \brief Reads header keys in the format `{"KEY":"VALUE",...}`
+     * 
+     * Keys are those used in build_data.list: GEO, ELE and POP
+     * for ids, and DEM, REP, LIB, REF, GRE, IND, OTH and TOT
+     * for voter data columns.
+     * 
+     * \param keys The key set to read
+     * \param ids Filled with id column headers
+     * \param parties Filled with voter data column headers
+     */
+    void ParseKeys(std::string keys, std::map<IdType, std::string>& ids, std::map<PoliticalParty, std::string>& parties);
+
+
+    /**
+     * \brief The census blocks of a state, stored compactly
+     * 
+     * Blocks are kept as parallel arrays indexed by block, without
+     * their geometry, so states with hundreds of thousands of blocks
+     * stay small. Bordering blocks are stored in compressed sparse
+     * row form: the neighbours of block `i` are `neighbors[offsets[i]]`
+     * up to `neighbors[offsets[i + 1]]`, in ascending order.
+     */
+    class CensusBlocks {
+        public:
+            std::vector<std::string>  ids;            //!< GEOID of each block
+            std::vector<int>          pop;            //!< Population of each block
+            std::vector<Point2d>      centroids;      //!< Area weighted centroid of each block
+            std::vector<double>       areas;          //!< Area of each block, in unscaled coordinates
+            std::vector<int>          precincts;      //!< Index of the precinct containing each block's centroid
+            std::vector<int>          offsets;        //!< Start of each block's neighbours, followed by the total
+            std::vector<int>          neighbors;      //!< Bordering blocks of every block
+            std::vector<double>       borderLengths;  //!< Shared border length for each entry of `neighbors`
+
+            int size() const { return ids.size(); }
+
+            /**
+             * \brief Builds the adjacency of the blocks as a graph
+             * \return A graph with a node for each block, keyed by
+             * its index, and the border length of each edge
+             */
+            Graph getGraph() const;
+    };
+
+
+    /**
+     * \brief Lines of points stored as 32 bit offsets from an origin
+     * 
+     * Points of every line are kept in one flat array of interleaved
+     * x and y offsets from the least coordinates, taking 8 bytes per
+     * point instead of 16. Length, bounds and shoelace sums are read
+     * straight from the offsets. On disk, each point is written as the
+     * varint of its difference from the one before it.
+     * 
+     * \throw Exceptions::CoordinateOverflow if the points span more
+     * than a 32 bit range
+     */
+    class CompactCoordinates {
+        public:
+            CompactCoordinates() : origin(0, 0) {}
+            CompactCoordinates(const std::vector<Point2dVec>& lines);
+
+            Point2d               origin;   //!< Least x and y of every point
+            std::vector<int32_t>  coords;   //!< Interleaved x and y offsets of every point
+            std::vector<int>      offsets;  //!< Index of each line's first point, followed by the total
+
+            int size() const { return offsets.empty() ? 0 : offsets.size() - 1; }              // number of lines
+            int getSize(int line) const { return offsets[line + 1] - offsets[line]; }           // points in a line
+            Point2d getPoint(int line, int i) const {
+                int k = 2 * (offsets[line] + i);
+                return {origin.x + coords[k], origin.y + coords[k + 1]};
+            }
+
+            Point2dVec   getLine(int line) const;
+            double       getLength(int line) const;        // total length of a line's segments
+            double       getShoelaceSum(int line) const;   // twice the signed area a line adds to a ring it's part of
+            BoundingBox  getBoundingBox(int line) const;   // all 0 for a line without points
+
+            std::string                encode() const;     // delta and varint encoded bytes
+            static CompactCoordinates  decode(const std::string& bytes);  // throws `Exceptions::StateFileInvalid` if the bytes are truncated
+    };
+
+
+    /**
+     * \brief Precinct borders stored as shared arcs
+     * 
+     * In the style of TopoJSON, each precinct ring is split into arcs
+     * at junctions, the points where neighbouring rings stop sharing
+     * a border. A border between two precincts is stored as one arc,
+     * that both rings refer to - the ring traced in the opposite
+     * direction refers to arc `i` as `~i`. Which precincts border
+     * each other, and the exterior border, follow from the arcs.
+     * 
+     * A state with a topology is written with its arcs in place of
+     * the precinct rings, so each shared border is stored once, and
+     * the rings are rebuilt from the arcs when it's read. Precincts
+     * still keep their own hull and holes in memory, which every
+     * geometry function reads, so the topology must be rebuilt or
+     * restored after they change. It is only built when generation
+     * finds or measures borders from it, or simplifies them.
+     */
+    class Topology {
+        public:
+            Topology(){}
+            Topology(const std::vector<Precinct>& precincts);
+
+            CompactCoordinates                 arcs;           //!< Points of each arc, in order
+            std::vector<std::vector<int> >     rings;          //!< Arcs of each ring, `~i` where arc `i` is reversed
+            std::vector<int>                   ringStarts;     //!< Position of each ring's first point after its first arc starts, or -1 for rings kept whole
+            std::vector<std::vector<int> >     precinctRings;  //!< Rings of each precinct, hull first and then holes
+            std::vector<std::array<int, 2> >   arcPrecincts;   //!< The precincts each arc borders, -1 where there are none
+
+            /**
+             * \brief Rebuilds the closed points of a ring
+             * \param ring Index of the ring
+             * \return The ring as it was when the topology was built
+             */
+            LinearRing getRing(int ring) const;
+            int getRingSize(int ring) const;            // points `getRing` rebuilds, including the closing point
+
+            double getArcLength(int arc) const;         // total length of an arc's segments
+            double getSignedArea(int precinct) const;   // area of a precinct's hull minus its holes
+            double getPerimeter(int precinct) const;    // total length of a precinct's rings
+            std::map<Edge, double> getBorderLengths() const;  // shared border length of each {low, high} pair of precincts
+            std::vector<int> getExteriorArcs() const;   // arcs that border only one precinct
+
+            /**
+             * \brief Measures every precinct from the compact arcs, measuring each arc once
+             * \return The area, perimeter and hull bounding box of each precinct
+             */
+            std::vector<PrecinctAttributes> getAttributes() const;
+
+            /**
+             * \brief Simplifies arcs without changing which precincts border
+             * 
+             * Runs Douglas-Peucker on each arc, keeping junctions, so
+             * shared borders stay identical on both sides. Arcs that
+             * would collapse a ring or cross another arc are kept as is.
+             * \param tolerance Largest distance a removed point may be from the simplified arc
+             * \return Number of points removed
+             */
+            int simplify(double tolerance);
+
+            /**
+             * \brief Fills the hull and holes of each precinct from the topology
+             * \param precincts The precincts the topology was built from
+             */
+            void restore(std::vector<Precinct>& precincts) const;
+    };
+
+
+    /**
+     * \brief Sections of a binary state file
+     * 
+     * Each section is a flat array of fixed width values, so it
+     * can be read with a single copy. Arrays are indexed by precinct
+     * unless noted, and `offsets` arrays hold the start of each
+     * item's entries in the next array, followed by the total.
+     * String sections hold `count + 1` int32 offsets followed by
+     * the characters of every string.
+     */
+    enum class StateSection : uint32_t {
+        PRECINCT_IDS = 1,               //!< Strings, shapeId of each precinct
+        PRECINCT_POP = 2,               //!< int32 population
+        PRECINCT_PARTS = 3,             //!< int32 `isPartOfMultiPolygon`
+        VOTER_PARTIES = 4,              //!< int32 `PoliticalParty` of each voter data column
+        VOTER_DATA = 5,                 //!< int32 votes, one column of every precinct per party, INT32_MIN where missing
+        RING_OFFSETS = 6,               //!< int32 offsets of each precinct's rings, hull first and then holes, without ARCS
+        RING_ORIGIN = 7,                //!< Point2d that ring points are offsets from, without ARCS
+        RING_POINT_OFFSETS = 8,         //!< int32 offsets of each ring's points, without ARCS
+        RING_POINTS = 9,                //!< int32 x and y offsets of every ring point, without ARCS
+        NODE_IDS = 10,                  //!< int32 id of each graph node, in order
+        NODE_EDGE_OFFSETS = 11,         //!< int32 offsets of each node's edges
+        NODE_EDGES = 12,                //!< int32 other node of each node's edges, in order
+        EDGES = 13,                     //!< int32 pairs, the graph's edge list
+        BORDER_LENGTHS = 14,            //!< {int32, int32, double} shared border length of each known edge
+        ATTRIBUTE_CENTROIDS = 15,       //!< Point2d centroid
+        ATTRIBUTE_AREAS = 16,           //!< double area
+        ATTRIBUTE_PERIMETERS = 17,      //!< double perimeter
+        ATTRIBUTE_BOUNDING_BOXES = 18,  //!< BoundingBox of the hull
+        ATTRIBUTE_HULL_OFFSETS = 19,    //!< int32 offsets of each convex hull's points
+        ATTRIBUTE_HULL_POINTS = 20,     //!< Point2d convex hull points
+        DISTRICT_IDS = 21,              //!< Strings, shapeId of each district
+        DISTRICT_POLYGON_OFFSETS = 22,  //!< int32 offsets of each district's polygons
+        DISTRICT_RING_OFFSETS = 23,     //!< int32 offsets of each district polygon's rings
+        DISTRICT_POINT_OFFSETS = 24,    //!< int32 offsets of each district ring's points
+        DISTRICT_POINTS = 25,           //!< Point2d district ring points
+        BLOCK_IDS = 26,                 //!< Strings, GEOID of each census block
+        BLOCK_POP = 27,                 //!< int32 population of each block
+        BLOCK_CENTROIDS = 28,           //!< Point2d centroid of each block
+        BLOCK_AREAS = 29,               //!< double area of each block
+        BLOCK_PRECINCTS = 30,           //!< int32 precinct of each block
+        BLOCK_OFFSETS = 31,             //!< int32 offsets of each block's neighbours
+        BLOCK_NEIGHBORS = 32,           //!< int32 bordering blocks
+        BLOCK_BORDER_LENGTHS = 33,      //!< double border length of each entry of BLOCK_NEIGHBORS
+        ARCS = 34,                      //!< Bytes, the topology's arcs as `CompactCoordinates::encode` writes them, which precinct rings are rebuilt from
+        ARC_PRECINCTS = 35,             //!< int32 pairs, the precincts each arc borders
+        RING_ARC_OFFSETS = 36,          //!< int32 offsets of each topology ring's arcs
+        RING_ARCS = 37,                 //!< int32 arcs of each topology ring, `~i` where arc `i` is reversed
+        RING_STARTS = 38,               //!< int32 start of each topology ring, as in `Topology::ringStarts`
+        PRECINCT_RING_OFFSETS = 39,     //!< int32 offsets of each precinct's topology rings
+        PRECINCT_RINGS = 40             //!< int32 topology rings of each precinct, hull first and then holes
+    };
+
+
+    /**
+     * \brief Start of a binary state file
+     * 
+     * Followed by `sections` entries of the section table, and then
+     * the data of each section, aligned to 8 bytes. Values are stored
+     * in the byte order of the machine that wrote them, which is
+     * little endian everywhere states are built.
+     */
+    struct StateFileHeader {
+        char      magic[8];  //!< Always `STATE_FILE_MAGIC`
+        uint32_t  version;   //!< Format version, at most `STATE_FILE_VERSION`
+        uint32_t  sections;  //!< Number of entries in the section table
+    };
+
+    /**
+     * \brief An entry of the section table of a binary state file
+     */
+    struct StateFileSection {
+        StateSection  id;
+        uint32_t      reserved;  //!< Always 0
+        uint64_t      offset;    //!< Start of the section, from the start of the file
+        uint64_t      size;      //!< Size of the section in bytes
+    };
+
+    /**
+     * \brief Which parts of a state file `State::fromFile` reads
+     */
+    enum class LoadMode {
+        FULL,          //!< Everything in the file
+        LAZY_GEOMETRY  //!< The graph, populations, votes and attributes. Each precinct's rings are read on first use
+    };
+
+    const char STATE_FILE_MAGIC[8] = {'H', 'T', 'E', 'S', 'T', 'A', 'T', 'E'};
+    const uint32_t STATE_FILE_VERSION = 2;  // 2 stores the rings of states with a topology only as arcs
+
+
     /**
      * \brief Shape class for defining a state.
      *        Includes arrays of precincts, and districts.
@@ -452,16 +821,191 @@ namespace hte {
             }
 
             // generate a file from proper raw input with and without additional voter data files
-            static State GenerateFromFile(DataParser&);
-            static State GenerateFromFile(std::string, std::string, std::map<PoliticalParty, std::string>, std::map<IdType, std::string>);
-            static State GenerateFromFile(std::string, std::string, std::string, std::map<PoliticalParty, std::string>, std::map<IdType, std::string>);
+            static State GenerateFromFile(DataParser&);  // streams geodata from the parser's file paths
+            static State GenerateFromFile(const std::string&, const std::string&, std::map<PoliticalParty, std::string>, std::map<IdType, std::string>, const DataParser& options = DataParser());  // options other than input paths are read from `options`
+            static State GenerateFromFile(const std::string&, const std::string&, const std::string&, std::map<PoliticalParty, std::string>, std::map<IdType, std::string>, const DataParser& options = DataParser());  // options other than input paths are read from `options`
+
+            // parse mapped files in place, without copying them into strings
+            static State GenerateFromFile(MappedFile&, MappedFile&, std::map<PoliticalParty, std::string>, std::map<IdType, std::string>, const DataParser& options = DataParser());  // options other than input paths are read from `options`
+            static State GenerateFromFile(MappedFile&, MappedFile&, MappedFile&, std::map<PoliticalParty, std::string>, std::map<IdType, std::string>, const DataParser& options = DataParser());  // options other than input paths are read from `options`
 
             Graph network; // represents the precinct network of the state
             std::vector<MultiPolygon> districts; // the actual districts of the state
+            std::vector<PrecinctAttributes> attributes; // derived geometry of each precinct, by index
+            CensusBlocks blocks; // census blocks of the state, if generated with them
+            Topology topology; // shared arcs of the precinct borders if generation needed them, written in place of the rings
+
+            /**
+             * \brief Computes the derived geometry of every precinct
+             * 
+             * Fills `attributes`, sets each precinct's hull centroid
+             * and applies the attributes to the precincts. When
+             * `topology` has rings for every precinct, which it must
+             * then match, areas, perimeters and bounds are measured
+             * from its arcs.
+             * \param threads Number of workers, or 0 for one per core
+             */
+            void computeAttributes(int threads = 0);
+
+            /**
+             * \brief Points each precinct at its entry of `attributes`,
+             * so their area, perimeter and bounds are read from it
+             */
+            void applyAttributes();
+
+            /**
+             * \brief Writes the state as a binary state file
+             * \param path The file path to write to
+             * \throw Exceptions::FileNotWritten if the file couldn't be written
+             * \see StateSection
+             */
+            void toFile(std::string path);
+
+            /**
+             * \brief Reads a state file, binary or a legacy text archive
+             * 
+             * With `LoadMode::LAZY_GEOMETRY`, precinct rings and the
+             * topology of a binary file are left in the mapped file, and
+             * each precinct reads its rings through `Precinct::loadGeometry`
+             * the first time geometry functions need them, rebuilding
+             * them from the arcs if the file stores them that way.
+             * 
+             * \param path The file path to read from
+             * \param mode Which parts of the file to read
+             * \return The state in the file
+             * \throw Exceptions::StateFileInvalid if a binary file is damaged or too new
+             */
+            static State fromFile(std::string path, LoadMode mode = LoadMode::FULL);
+
+            /**
+             * \brief Reads a state written as a Boost text archive,
+             * the format used before binary state files
+             * \param path The file path to read from
+             * \return The state in the file
+             */
+            static State fromTextFile(std::string path);
 
-            // serialize and read to and from binary, json
-            void            toFile(std::string path);
-            static State    fromFile(std::string path);
+            /**
+             * \brief Reads a state published to shared memory
+             * 
+             * Lazily loaded precincts read their rings from the shared
+             * segment, so worker processes attached to the same state
+             * hold a single copy of its geometry between them.
+             * 
+             * \param name The name the state was published under
+             * \param mode Which parts of the state to read
+             * \return The published state
+             * \see StateView::publish
+             */
+            static State fromSharedMemory(std::string name, LoadMode mode = LoadMode::LAZY_GEOMETRY);
+
+            /**
+             * \brief Reads a state from a mapped binary state file
+             * \param view The mapped state, kept by lazily loaded precincts
+             * \param mode Which parts of the state to read
+             * \return The state in the view
+             */
+            static State fromView(std::shared_ptr<const StateView> view, LoadMode mode = LoadMode::FULL);
+    };
+
+
+    /**
+     * \brief A read only view of a contiguous array
+     * 
+     * Points into memory owned by something else, such as
+     * a `StateView`, and is only valid while its owner is.
+     */
+    template<typename T> class Span {
+        public:
+            typedef T value_type;
+
+            Span() {}
+            Span(const T* data, size_t size) : data_(data), size_(size) {}
+
+            const T*  begin() const { return data_; }
+            const T*  end() const { return data_ + size_; }
+            const T*  data() const { return data_; }
+            size_t    size() const { return size_; }
+            bool      empty() const { return size_ == 0; }
+
+            const T& operator[](size_t i) const { return data_[i]; }
+            Span<T> subspan(size_t offset, size_t count) const { return Span<T>(data_ + offset, count); }  // as `std::span::subspan`
+
+        private:
+            const T* data_ = nullptr;
+            size_t size_ = 0;
+    };
+
+
+    /**
+     * \brief A binary state file mapped read only into memory
+     * 
+     * Exposes the sections of the file as spans into the mapping,
+     * without building `Precinct` or `Node` objects, so opening even
+     * a large state is near instant. The file is mapped shared, so
+     * processes viewing the same state share its pages through the
+     * page cache. Arrays are indexed as in `StateSection`. Precinct
+     * rings stored as arcs are the exception, as the arcs are varint
+     * encoded: they're decoded once when mapped, and each ring is
+     * rebuilt from them when it's read.
+     * 
+     * A loader process can also `publish` a state file to a POSIX
+     * shared memory segment, which worker processes `attach` to
+     * read only, without the state needing to be on disk.
+     * 
+     * \throw Exceptions::FileNotMapped if the file can't be mapped
+     * \throw Exceptions::StateFileInvalid if it isn't a binary state file
+     */
+    class StateView {
+        public:
+            StateView(std::string path);
+            ~StateView();
+
+            StateView(const StateView&) = delete;
+            StateView& operator=(const StateView&) = delete;
+
+            /**
+             * \brief Copies a binary state file into a shared memory segment
+             * \param path The state file to publish
+             * \param name Name of the segment, such as `/hte-nc`
+             */
+            static void publish(std::string path, std::string name);
+            static void unpublish(std::string name);  // remove a published segment's name
+            static std::shared_ptr<const StateView> attach(std::string name);  // map a published segment read only
+
+            Span<int32_t>      pop;             //!< Population of each precinct
+            Span<int32_t>      voterParties;    //!< `PoliticalParty` of each voter data column
+            Span<int32_t>      voterData;       //!< Voter data columns, INT32_MIN where missing
+            Span<int32_t>      ringOffsets;     //!< Start of each precinct's rings, hull first, empty with `topology`
+            Span<int32_t>      pointOffsets;    //!< Start of each ring's points, empty with `topology`
+            Span<int32_t>      points;          //!< Interleaved x and y offsets from `origin` of every ring point, empty with `topology`
+            Point2d            origin;          //!< Point that ring points are offsets from
+            Topology           topology;        //!< Arcs the precinct rings are rebuilt from, decoded when mapped, if the file stores them
+            Span<int32_t>      nodeIds;         //!< Id of each graph node
+            Span<int32_t>      edgeOffsets;     //!< Start of each node's neighbours
+            Span<int32_t>      neighbors;       //!< Neighbouring node ids of every node
+            Span<Point2d>      centroids;       //!< Centroid of each precinct, if stored
+            Span<double>       areas;           //!< Area of each precinct, if stored
+            Span<double>       perimeters;      //!< Perimeter of each precinct, if stored
+            Span<BoundingBox>  boundingBoxes;   //!< Bounding box of each precinct, if stored
+
+            int size() const { return pop.size(); }  // number of precincts
+
+            std::string_view  getPrecinctId(int precinct) const;
+            int               getVotes(int precinct, PoliticalParty party) const;  // votes for `party`, or 0 if missing
+            int               getRingCount(int precinct) const;  // number of rings of a precinct, hull and holes
+            LinearRing        getRing(int precinct, int i) const;  // ring `i` of a precinct, hull first, from the arcs if stored
+            Span<int32_t>     getNeighbors(int node) const;    // ids of the nodes bordering a node, by index
+            Span<char>        getSection(StateSection id) const;  // raw bytes of a section, empty if missing
+            Span<char>        getData() const { return Span<char>(data_, size_); }  // the whole mapping
+
+        private:
+            StateView() {}
+            void map(int fd);
+
+            char* data_ = nullptr;
+            size_t size_ = 0;
+            std::map<StateSection, Span<char> > sections_;
     };
 
 
@@ -486,7 +1030,39 @@ namespace hte {
     Polygon StringToPoly(std::string str, bool texas_coordinates);
 
     // parsing functions for tsv files
-    std::vector<std::vector<std::string > > parseSV(std::string, std::string);
+    std::vector<std::vector<std::string > > parseSV(std::string_view, std::string_view);
+
+    /**
+     * \brief Election data, as a column of votes for each party
+     * 
+     * Rows are in the order of the election file. Cells that didn't
+     * hold a number are marked in `filled`, since parties without
+     * data are left out of a precinct's votes.
+     */
+    class VoterTable {
+        public:
+            std::vector<std::string>               ids;      //!< Precinct id of each row
+            std::vector<PoliticalParty>            parties;  //!< Party of each column
+            std::vector<std::vector<int> >         votes;    //!< Votes of every row, one column per party
+            std::vector<std::vector<char> >        filled;   //!< Whether each cell of `votes` held a number
+            std::unordered_map<std::string, int>   rows;     //!< Last row of each precinct id
+
+            std::map<PoliticalParty, int> getVotes(int row) const;  // votes of a row's filled cells
+    };
+
+
+    /**
+     * \brief Combines precinct shapes with their election data
+     * 
+     * Pieces of a multipolygon precinct are split into separate
+     * precincts, each receiving a share of the votes proportional
+     * to its area.
+     * 
+     * \param precinctShapes Precinct geodata, with ids
+     * \param voterData Votes for each party, with a row per precinct id
+     * \return A precinct for every shape
+     */
+    std::vector<Precinct> MergeData(std::vector<Polygon>& precinctShapes, const VoterTable& voterData);
     
     /**
      * Contains a list of precincts, as well as information about
@@ -520,8 +1096,9 @@ namespace hte {
     double GetScalarizedMetric(Communities& cs);
     int GetNumPrecinctsChanged(Graph& g1, Graph& g2);
 
-    void SaveCommunitiesToFile(Communities, std::string);
-    Communities LoadCommunitiesFromFile(std::string, Graph&);
+    void SaveCommunitiesToFile(Communities, std::string);    // binary node -> community assignment
+    void ExportCommunitiesToText(Communities, std::string);  // python style list of precinct ids for each community
+    Communities LoadCommunitiesFromFile(std::string, Graph&);  // reads binary or exported text files
     Communities LoadCommunitiesWithQuantification(std::string, Graph&, std::string);
     std::vector<std::vector<double> > LoadQuantification(std::string tsv);
 
@@ -536,8 +1113,60 @@ namespace hte {
      * rtition
      */
     Communities KargerStein(Graph& graph, int nCommunities);
-    void GradientDescentOptimization(Graph& g, Communities& cs, double (*measure)(Communities&));
-    void SimulatedAnnealingOptimization(Graph& g, Communities& cs, double (*measure)(Community&));
+
+
+    /**
+     * \brief Progress of an optimization run
+     * 
+     * Saved periodically by the optimizers when given a checkpoint
+     * path, so that a run that is stopped can be started again with
+     * the same path and resume exactly where it was saved.
+     */
+    class OptimizationCheckpoint {
+        public:
+            int epoch = 0;             //!< Epochs or steps completed
+            double temperature = 0;    //!< Annealing temperature
+            double measure = 0;        //!< Measure of the current communities
+            double bestMeasure = 0;    //!< Measure of the best communities found
+            std::string rng;           //!< State of the optimizer's random engine
+            size_t graph = 0;          //!< Hash of the node ids and edges of the graph being optimized
+
+            std::vector<std::vector<int> > communities;  //!< Node ids of each community, in order
+            std::vector<std::vector<int> > best;         //!< Node ids of each of the best communities found
+
+            /**
+             * \brief Writes the checkpoint to a temporary file and renames
+             * it over `path`, so a run stopped mid-write keeps the last one
+             * \param path The file path to write to
+             */
+            void save(std::string path) const;
+
+            /**
+             * \brief Reads a checkpoint written by `save`, leaving
+             * this one unchanged if it can't be read
+             * \param path The file path to read from
+             * \return Whether a checkpoint was read
+             */
+            bool load(std::string path);
+    };
+
+    /**
+     * \brief Repeatedly makes the exchange that most improves `measure`, until none do
+     * \param checkpoint Path to save progress to and resume from, or empty
+     * \param checkpointInterval Steps between saved checkpoints
+     * \throw Exceptions::CheckpointMismatch if the checkpoint was saved from another graph
+     * \throw Exceptions::CheckpointIntervalInvalid if the interval isn't positive
+     */
+    void GradientDescentOptimization(Graph& g, Communities& cs, double (*measure)(Communities&), std::string checkpoint = "", int checkpointInterval = 1);
+
+    /**
+     * \brief Anneals communities toward a lower average `measure`
+     * \param checkpoint Path to save progress to and resume from, or empty
+     * \param checkpointInterval Epochs between saved checkpoints
+     * \throw Exceptions::CheckpointMismatch if the checkpoint was saved from another graph
+     * \throw Exceptions::CheckpointIntervalInvalid if the interval isn't positive
+     */
+    void SimulatedAnnealingOptimization(Graph& g, Communities& cs, double (*measure)(Community&), std::string checkpoint = "", int checkpointInterval = 1000);
 
     double CollapseVals(double a, double b);
     double GetPopulationFromMask(PrecinctGroup pg, MultiPolygon mp);
@@ -562,6 +1191,60 @@ namespace hte {
                     return "Points LinearRing do not form closed ring";
                 }
             };
+
+            struct FileNotMapped : public std::exception {
+                const char* what() const throw() {
+                    return "File could not be opened and mapped into memory";
+                }
+            };
+
+            struct FileNotRead : public std::exception {
+                const char* what() const throw() {
+                    return "File could not be opened or read";
+                }
+            };
+
+            struct GeoJsonInvalid : public std::exception {
+                const char* what() const throw() {
+                    return "Geojson file could not be parsed";
+                }
+            };
+
+            struct FileNotWritten : public std::exception {
+                const char* what() const throw() {
+                    return "File could not be opened or written";
+                }
+            };
+
+            struct CoordinateOverflow : public std::exception {
+                const char* what() const throw() {
+                    return "Coordinates are too far apart to store as 32 bit offsets";
+                }
+            };
+
+            struct StateFileInvalid : public std::exception {
+                const char* what() const throw() {
+                    return "State file is damaged or was written by a newer version";
+                }
+            };
+
+            struct CommunitiesFileInvalid : public std::exception {
+                const char* what() const throw() {
+                    return "Communities file is damaged or was written by a newer version";
+                }
+            };
+
+            struct CheckpointMismatch : public std::exception {
+                const char* what() const throw() {
+                    return "Checkpoint was saved while optimizing a different graph";
+                }
+            };
+
+            struct CheckpointIntervalInvalid : public std::exception {
+                const char* what() const throw() {
+                    return "Checkpoint interval must be positive";
+                }
+            };
     };
     
     /**
@@ -569,7 +1252,7 @@ namespace hte {
      * \param token The string to check
      * \return Whether or not the string is a float, double, or int
      */
-    bool IsNumber(std::string token);
+    bool IsNumber(std::string_view token);
     
     /**
      * \brief Writes (if possible) text to a specified file
@@ -584,6 +1267,68 @@ namespace hte {
      * \return The contents of the file
      */
     std::string ReadFile(std::string path);
+
+
+    /**
+     * \brief Finds whether strings contain any of a set of patterns
+     * 
+     * Builds an Aho-Corasick automaton over the patterns, so each
+     * string is checked for every pattern in a single pass. Empty
+     * patterns are ignored, rather than matching every string.
+     */
+    class SubstringMatcher {
+        public:
+            SubstringMatcher(const std::vector<std::string>& patterns);
+
+            /**
+             * \brief Whether `str` contains any of the patterns
+             * \param str The string to search
+             * \return Whether a pattern was found
+             */
+            bool matches(std::string_view str) const;
+
+        private:
+            std::vector<std::array<int, 256> > next_;  // transitions for each state and byte
+            std::vector<bool> accepting_;              // states that end a pattern
+    };
+
+
+    /**
+     * \brief Hashes the contents of a file with 64 bit FNV-1a
+     * \param path The file path to hash
+     * \return The hash of the file's contents
+     * \throw Exceptions::FileNotMapped if the file can't be read
+     */
+    uint64_t HashFile(std::string path);
+
+
+    /**
+     * \brief A file mapped privately into memory
+     * 
+     * The mapping is followed by a null byte, so the contents can be
+     * handed straight to rapidjson's `ParseInsitu` without copying
+     * them into a string. Writes go to private copies of the pages,
+     * never to the file on disk, but an in-situ parse consumes the
+     * contents, so a mapped file can only be parsed once.
+     * 
+     * \throw Exceptions::FileNotMapped if the file can't be mapped
+     */
+    class MappedFile {
+        public:
+            MappedFile(std::string path);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            char* data() { return data_; }        //!< Null terminated file contents
+            size_t size() const { return size_; }  //!< Size of the file in bytes
+
+        private:
+            char* data_ = nullptr;
+            size_t size_ = 0;
+            size_t mappedSize_ = 0;
+    };
        
     /**
      * \brief Joins a std::vector<> by a delimeter
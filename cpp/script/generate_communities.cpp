@@ -23,8 +23,29 @@ double GetCompactnessToMinimize(Communities& c) {
 }
 
 int main(int argc, char* argv[]) {
-    State state = State::fromFile(argv[1]);
-    Communities cs = KargerStein(state.network, stoi(argv[2]));
+    string CHECKPOINT = "--checkpoint=";  // path to save progress to and resume from
+    string EVERY = "--checkpoint-every=";  // steps between saved checkpoints
+
+    vector<string> new_argv{};
+    string checkpoint;
+    int checkpointInterval = 1;
+
+    for (int i = 0; i < argc; i++) {
+        string arg = string(argv[i]);
+        if (arg.substr(0, CHECKPOINT.size()) == CHECKPOINT) checkpoint = arg.substr(CHECKPOINT.size());
+        else if (arg.substr(0, EVERY.size()) == EVERY) checkpointInterval = stoi(arg.substr(EVERY.size()));
+        else new_argv.push_back(arg);
+    }
+
+    if (new_argv.size() != 3) {
+        cerr << "generate_communities: usage: <state|shm:name> <communities> [--checkpoint=path] [--checkpoint-every=steps]" << endl;
+        return 1;
+    }
+
+    // `shm:/name` attaches to a state published with publish_state
+    string source = new_argv[1];
+    State state = (source.substr(0, 4) == "shm:") ? State::fromSharedMemory(source.substr(4)) : State::fromFile(source);
+    Communities cs = KargerStein(state.network, stoi(new_argv[2]));
     for (int i = 0; i < cs.size(); i++) {
         cs[i].resetShape(state.network);
     }
@@ -34,7 +55,8 @@ int main(int argc, char* argv[]) {
     c.drawToWindow();
     c.clear();
 
-    GradientDescentOptimization(state.network, cs, GetCompactnessToMinimize);
+    // a run stopped and started again with the same checkpoint resumes from it
+    GradientDescentOptimization(state.network, cs, GetCompactnessToMinimize, checkpoint, checkpointInterval);
     c.addOutlines(ToOutline(cs));
     c.drawToWindow();
     return 0;
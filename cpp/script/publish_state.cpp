@@ -0,0 +1,59 @@
+/*=======================================
+ publish_state.cpp:             k-vernooy
+ last modified:               Fri, Oct 16
+
+ Publishes a binary state file to POSIX
+ shared memory for generate_communities
+ workers to attach to with `shm:name`,
+ or removes a published state.
+========================================*/
+
+#include <iostream>
+#include "../include/hte.h"
+
+using namespace std;
+using namespace hte;
+
+
+int main(int argc, char* argv[]) {
+    string UNPUBLISH = "--unpublish";  // remove the segment's name instead of publishing
+
+    bool unpublish = false;
+    vector<string> new_argv{};
+
+    for (int i = 0; i < argc; i++) {
+        string arg = string(argv[i]);
+        if (arg == UNPUBLISH) unpublish = true;
+        else new_argv.push_back(arg);
+    }
+
+    if (new_argv.size() != (unpublish ? 2 : 3)) {
+        cerr << "publish_state: usage: <state file> <name> | --unpublish <name>" << endl;
+        return 1;
+    }
+
+    string name = new_argv.back();
+    if (name.empty() || name[0] != '/') name = "/" + name;
+
+    if (unpublish) {
+        // attached workers keep their mapping until they exit
+        StateView::unpublish(name);
+        cout << "unpublished " << name << endl;
+        return 0;
+    }
+
+    try {
+        StateView::publish(new_argv[1], name);
+
+        // map it back once, so a damaged file fails here and not in every worker
+        StateView::attach(name);
+    }
+    catch (exception& e) {
+        StateView::unpublish(name);
+        cerr << "\e[31merror: \e[0m" << e.what() << endl;
+        return 1;
+    }
+
+    cout << "published " << new_argv[1] << " as " << name << ", run workers with shm:" << name << endl;
+    return 0;
+}
@@ -0,0 +1,331 @@
+/*=======================================
+ serialize_all.cpp:             k-vernooy
+ last modified:               Sun, Jun 21
+
+ Serializes every state in build_data.list
+ (or those named on the command line),
+ running several states at once in
+ separate worker processes.
+========================================*/
+
+#include <iostream>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../include/hte.h"
+
+using namespace std;
+using namespace hte;
+
+// worker exit status for a state that was already up to date
+const int UNCHANGED = 2;
+
+
+/**
+ * \brief One state's line of build_data.list
+ */
+struct BuildEntry {
+    string name;
+    vector<string> inputs;  // geodata, [election data], district geodata
+    string keys;
+    string output;
+    vector<string> nonPrecinctIds = DataParser().nonPrecinctIds;
+    string blocks;  // census block geodata, if any
+};
+
+
+/**
+ * \brief Output buffer that prefixes each line with a name
+ *
+ * Whole lines are written to `fd` in a single call, so output
+ * from workers sharing a terminal doesn't interleave mid-line.
+ */
+class PrefixBuffer : public streambuf {
+    public:
+        PrefixBuffer(string prefix, int fd) : prefix_(prefix), line_(prefix), fd_(fd) {}
+        ~PrefixBuffer() { emit(); }
+
+    protected:
+        int overflow(int c) {
+            if (c == EOF) return 0;
+            line_ += static_cast<char>(c);
+            if (c == '\n') emit();
+            return c;
+        }
+
+        int sync() {
+            // flushing the stream writes a partial line as it is
+            emit();
+            return 0;
+        }
+
+    private:
+        void emit() {
+            // write any buffered text as one labelled line
+            if (line_.size() > prefix_.size()) {
+                if (line_.back() != '\n') line_ += '\n';
+                if (write(fd_, line_.data(), line_.size()) < 0) {}
+                line_ = prefix_;
+            }
+        }
+
+        string prefix_;
+        string line_;
+        int fd_;
+};
+
+
+vector<BuildEntry> ReadBuildList(string path, string raw, string out) {
+    /*
+        @desc:
+            reads the states of a build list, in the format
+            `"name": inputs... --keys='{...}' [--non-precinct-ids=a,b] [--blocks=blocks.json] output.state`
+
+        @params:
+            `string` path: path to build_data.list
+            `string` raw: directory that inputs are relative to
+            `string` out: directory that outputs are relative to
+
+        @return: `vector<BuildEntry>` states in the list
+    */
+
+    vector<BuildEntry> entries;
+    stringstream file(ReadFile(path));
+    string line;
+
+    while (getline(file, line)) {
+        // skip comments and blank lines
+        size_t start = line.find_first_not_of(" \t");
+        if (start == string::npos || line[start] == '#') continue;
+        if (line[start] != '"' || line.find("\":", start + 1) == string::npos) continue;
+
+        BuildEntry entry;
+        size_t nameEnd = line.find("\":", start + 1);
+        entry.name = line.substr(start + 1, nameEnd - start - 1);
+
+        stringstream args(line.substr(nameEnd + 2));
+        string arg;
+
+        while (args >> arg) {
+            string ext = arg.substr(arg.rfind('.') + 1);
+
+            if (arg.substr(0, 7) == "--keys=") {
+                entry.keys = arg.substr(7);
+                if (entry.keys.size() > 1 && entry.keys.front() == '\'' && entry.keys.back() == '\'')
+                    entry.keys = entry.keys.substr(1, entry.keys.size() - 2);
+            }
+            else if (arg.substr(0, 19) == "--non-precinct-ids=") entry.nonPrecinctIds = Split(arg.substr(19), ",");
+            else if (arg.substr(0, 9) == "--blocks=") entry.blocks = raw + arg.substr(9);
+            else if (ext == "json" || ext == "tab") entry.inputs.push_back(raw + arg);
+            else if (ext == "state") entry.output = out + arg;
+        }
+
+        if (entry.inputs.size() < 2 || entry.inputs.size() > 3 || entry.keys.empty() || entry.output.empty()) {
+            cerr << "serialize_all: skipping malformed entry for " << entry.name << endl;
+            continue;
+        }
+
+        entries.push_back(entry);
+    }
+
+    return entries;
+}
+
+
+int SerializeEntry(const BuildEntry& entry, AdjacencyMethod adjacency, double simplify, bool borderLengths, int threads, bool force) {
+    /*
+        @desc:
+            generates and writes one state, run in a worker process.
+            States whose manifest matches the one saved with them
+            are skipped unless `force` is set
+
+        @params:
+            `BuildEntry` entry: the state to serialize
+            `AdjacencyMethod` adjacency: how to find bordering precincts
+            `double` simplify: tolerance for simplifying precinct borders, or 0
+            `bool` borderLengths: store the shared border length of every edge
+            `int` threads: workers for finding bordering precincts
+            `bool` force: generate the state even if it's up to date
+
+        @return: `int` exit status of the worker
+    */
+
+    vector<string> inputs = entry.inputs;
+    if (!entry.blocks.empty()) inputs.push_back(entry.blocks);
+
+    for (const string& input : inputs) {
+        if (!boost::filesystem::exists(input)) {
+            cout << "\e[31merror: \e[0mmissing input " << input << endl;
+            return 1;
+        }
+    }
+
+    map<IdType, string> ids;
+    map<PoliticalParty, string> voterHeads;
+    ParseKeys(entry.keys, ids, voterHeads);
+
+    DataParser parser;
+    if (entry.inputs.size() == 3) parser = DataParser(entry.inputs[0], entry.inputs[1], entry.inputs[2], voterHeads, ids);
+    else parser = DataParser(entry.inputs[0], entry.inputs[1], voterHeads, ids);
+
+    parser.adjacency = adjacency;
+    parser.threads = threads;
+    parser.nonPrecinctIds = entry.nonPrecinctIds;
+    parser.blockFile = entry.blocks;
+    parser.simplifyTolerance = simplify;
+    parser.borderLengths = borderLengths;
+
+    try {
+        string manifestPath = entry.output + ".manifest";
+        string manifest = parser.getManifest();
+
+        if (!force && boost::filesystem::exists(entry.output) && ReadFile(manifestPath) == manifest) {
+            return UNCHANGED;
+        }
+
+        State state = State::GenerateFromFile(parser);
+        if (state.precincts.empty() || state.districts.empty()) {
+            cout << "\e[31merror: \e[0mno precincts or districts were parsed" << endl;
+            return 1;
+        }
+
+        state.toFile(entry.output);
+        WriteFile(manifest, manifestPath);
+        cout << "state written to " << entry.output << endl;
+    }
+    catch (exception& e) {
+        cout << "\e[31merror: \e[0m" << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    string JOBS = "--jobs=";             // number of states to serialize at once
+    string LIST = "--list=";             // path to the build list
+    string RAW = "--raw=";               // directory holding raw data
+    string OUT = "--out=";               // directory to write states to
+    string ADJACENCY = "--adjacency=";   // `clip` or `segments` adjacency detection
+    string SIMPLIFY = "--simplify=";     // tolerance for simplifying precinct borders
+    string FORCE = "--force";            // regenerate states with unchanged inputs
+    string BORDERS = "--border-lengths"; // store the shared border length of every edge
+
+    int cores = max(1, static_cast<int>(thread::hardware_concurrency()));
+    int jobs = cores;
+    string listPath = "build/build_data.list";
+    string raw = "../../data/raw/";
+    string out = "../../data/bin/cpp/";
+    AdjacencyMethod adjacency = AdjacencyMethod::CLIP;
+    double simplify = 0;
+    vector<string> only;
+    bool force = false;
+    bool borderLengths = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = string(argv[i]);
+
+        if (arg.substr(0, JOBS.size()) == JOBS) jobs = max(1, stoi(arg.substr(JOBS.size())));
+        else if (arg.substr(0, LIST.size()) == LIST) listPath = arg.substr(LIST.size());
+        else if (arg.substr(0, RAW.size()) == RAW) raw = arg.substr(RAW.size());
+        else if (arg.substr(0, OUT.size()) == OUT) out = arg.substr(OUT.size());
+        else if (arg == ADJACENCY + "segments") adjacency = AdjacencyMethod::SEGMENTS;
+        else if (arg == ADJACENCY + "clip") adjacency = AdjacencyMethod::CLIP;
+        else if (arg.substr(0, SIMPLIFY.size()) == SIMPLIFY) simplify = stod(arg.substr(SIMPLIFY.size()));
+        else if (arg == FORCE) force = true;
+        else if (arg == BORDERS) borderLengths = true;
+        else if (arg.substr(0, 2) == "--") {
+            cerr << "serialize_all: usage: " <<
+                "[--jobs=n] [--list=path] [--raw=dir] [--out=dir] [--adjacency=clip|segments] [--simplify=tolerance] [--border-lengths] [--force] [states...]" << endl;
+            return 1;
+        }
+        else only.push_back(arg);
+    }
+
+    vector<BuildEntry> entries;
+    for (BuildEntry& entry : ReadBuildList(listPath, raw, out)) {
+        if (only.empty() || find(only.begin(), only.end(), entry.name) != only.end())
+            entries.push_back(entry);
+    }
+
+    // split the cores between the states being serialized
+    int threads = max(1, cores / min(jobs, max(1, static_cast<int>(entries.size()))));
+    cout << "serializing " << entries.size() << " states with " << jobs << " workers" << endl;
+
+    map<pid_t, pair<string, chrono::steady_clock::time_point> > running;
+    int next = 0, finished = 0, failed = 0, unchanged = 0;
+
+    while (next < entries.size() || !running.empty()) {
+        // start workers until all job slots are full
+        while (next < entries.size() && running.size() < jobs) {
+            const BuildEntry& entry = entries[next++];
+            cout.flush();
+            pid_t pid = fork();
+
+            if (pid == 0) {
+                // worker: label all output with the state's name
+                PrefixBuffer outBuffer("[" + entry.name + "] ", STDOUT_FILENO);
+                PrefixBuffer errBuffer("[" + entry.name + "] ", STDERR_FILENO);
+                cout.rdbuf(&outBuffer);
+                cerr.rdbuf(&errBuffer);
+
+                int status = SerializeEntry(entry, adjacency, simplify, borderLengths, threads, force);
+                cout.flush();
+                cerr.flush();
+                _exit(status);
+            }
+            else if (pid < 0) {
+                // try again once a running worker exits, if there are any
+                if (!running.empty()) {
+                    next--;
+                    break;
+                }
+
+                cerr << "serialize_all: could not start worker for " << entry.name << endl;
+                failed++;
+                finished++;
+                continue;
+            }
+
+            running[pid] = {entry.name, chrono::steady_clock::now()};
+        }
+
+        // wait for a worker to finish
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0 && errno == EINTR) continue;
+
+        if (pid < 0) {
+            // nothing left to wait for, so states that didn't finish failed
+            failed += entries.size() - finished;
+            break;
+        }
+
+        auto worker = running.find(pid);
+        if (worker == running.end()) continue;
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - worker->second.second;
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        finished++;
+
+        cout << "[" << finished << "/" << entries.size() << "] " << worker->second.first << ": ";
+        if (code == UNCHANGED) {
+            unchanged++;
+            cout << "up to date" << endl;
+        }
+        else if (code == 0) cout << "done in " << elapsed.count() << "s" << endl;
+        else {
+            failed++;
+            cout << "\e[31mfailed\e[0m in " << elapsed.count() << "s" << endl;
+        }
+
+        running.erase(worker);
+    }
+
+    cout << entries.size() - failed - unchanged << " of " << entries.size() << " states serialized, "
+         << unchanged << " up to date" << endl;
+    return (failed == 0) ? 0 : 1;
+}
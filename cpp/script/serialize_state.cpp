@@ -19,11 +19,18 @@ using namespace hte;
 
 int main(int argc, char* argv[]) {
     string KEY = "--keys=";  // prefix to find specified options
+    string STREAM = "--stream";  // stream geodata instead of reading whole files
+    string ADJACENCY = "--adjacency=";  // `clip` or `segments` adjacency detection
+    string NONPRECINCT = "--non-precinct-ids=";  // comma separated ids of water and other non-precincts
+    string BLOCKS = "--blocks=";  // census block geodata to aggregate into precincts
+    string SIMPLIFY = "--simplify=";  // tolerance for simplifying precinct borders
+    string FORCE = "--force";  // generate the state even if its inputs are unchanged
+    string BORDERS = "--border-lengths";  // store the shared border length of every edge
 
     if (argc < 5) {
         // did not provide infiles and keys
         cerr << "serialize_state: usage: " <<
-            "<geodata> <election> <district> --keys=[keys] outfile" << endl;
+            "<geodata> <election> <district> --keys=[keys] [--stream] [--adjacency=clip|segments] [--non-precinct-ids=a,b,...] [--blocks=geodata] [--simplify=tolerance] [--border-lengths] [--force] outfile" << endl;
         return 1;
     }
 
@@ -31,6 +38,13 @@ int main(int argc, char* argv[]) {
 
     map<IdType, string> ids;
     map<PoliticalParty, string> voter_heads;
+    bool stream = false;
+    bool force = false;
+    bool borderLengths = false;
+    AdjacencyMethod adjacency = AdjacencyMethod::CLIP;
+    vector<string> nonPrecinctIds = DataParser().nonPrecinctIds;
+    string blockFile;
+    double simplifyTolerance = 0;
 
 
     for (int i = 0; i < argc; i++) {
@@ -38,65 +52,92 @@ int main(int argc, char* argv[]) {
         string arg = string(argv[i]);
 
         if (arg.substr(0, KEY.size()) == KEY) {
-            bool done = false;
-            while (!done) {
-                string rem = arg.substr(arg.find('"'), arg.size());
-                string key = rem.substr(0, rem.find(":"));
-                key = string(key.begin() + 1, key.end() - 1);
-
-                string search = ",";
-                if (rem.find(search) == string::npos) {
-                    search = "}";
-                    done = true;
-                }
-
-                string val = rem.substr(rem.find(":") + 1, rem.find(search) - rem.find(":") - 1);
-                val = string(val.begin() + 1, val.end() - 1);
-
-                if (key == "GEO") ids[IdType::GEOID] = val;
-                else if (key == "ELE") ids[IdType::ELECTIONID] = val;
-                else if (key == "POP") ids[IdType::POPUID] = val;
-                else if (key == "DEM") voter_heads[PoliticalParty::Democrat] = val;
-                else if (key == "REP") voter_heads[PoliticalParty::Republican] = val;
-                else if (key == "LIB") voter_heads[PoliticalParty::Libertarian] = val;
-                else if (key == "REF") voter_heads[PoliticalParty::Reform] = val;
-                else if (key == "GRE") voter_heads[PoliticalParty::Green] = val;
-                else if (key == "IND") voter_heads[PoliticalParty::Independent] = val;                
-                else if (key == "OTH") voter_heads[PoliticalParty::Other] = val;
-                else if (key == "TOT") voter_heads[PoliticalParty::Total] = val;
-                else cout << "unrecognized key " << key << endl;
-
-                if (!done) arg = rem.substr(rem.find(","), rem.size() - rem.find(","));
+            ParseKeys(arg, ids, voter_heads);
+        }
+        else if (arg == STREAM) {
+            stream = true;
+        }
+        else if (arg == FORCE) {
+            force = true;
+        }
+        else if (arg == BORDERS) {
+            borderLengths = true;
+        }
+        else if (arg.substr(0, ADJACENCY.size()) == ADJACENCY) {
+            string method = arg.substr(ADJACENCY.size());
+            if (method == "segments") adjacency = AdjacencyMethod::SEGMENTS;
+            else if (method == "clip") adjacency = AdjacencyMethod::CLIP;
+            else {
+                cerr << "serialize_state: unrecognized adjacency method " << method << endl;
+                return 1;
             }
         }
+        else if (arg.substr(0, SIMPLIFY.size()) == SIMPLIFY) {
+            simplifyTolerance = stod(arg.substr(SIMPLIFY.size()));
+        }
+        else if (arg.substr(0, BLOCKS.size()) == BLOCKS) {
+            blockFile = arg.substr(BLOCKS.size());
+        }
+        else if (arg.substr(0, NONPRECINCT.size()) == NONPRECINCT) {
+            nonPrecinctIds = Split(arg.substr(NONPRECINCT.size()), ",");
+        }
         else {
             // not a key arg
             new_argv.push_back(arg);
         }
     }
 
-    argc--;
+    argc = new_argv.size();
     State state;
     string write_path;
 
-    // generate state from files
+    // describe the files and options the state is generated from
+    DataParser parser;
     if (argc == 5) {
-        // read files into strings
-        string precinct_geoJSON = ReadFile(new_argv[1]);
-        string voter_data = ReadFile(new_argv[2]);
-        string district_geoJSON = ReadFile(new_argv[3]);
+        parser = DataParser(new_argv[1], new_argv[2], new_argv[3], voter_heads, ids);
         write_path = string(new_argv[4]);
-        state = State::GenerateFromFile(precinct_geoJSON, voter_data, district_geoJSON, voter_heads, ids);
     }
     else {
-        // read files into strings
-        string precinct_geoJSON = ReadFile(new_argv[1]);
-        string district_geoJSON = ReadFile(new_argv[2]);
+        parser = DataParser(new_argv[1], new_argv[2], voter_heads, ids);
         write_path = string(new_argv[3]);
-        state = State::GenerateFromFile(precinct_geoJSON, district_geoJSON, voter_heads, ids);
+    }
+
+    parser.adjacency = adjacency;
+    parser.nonPrecinctIds = nonPrecinctIds;
+    parser.blockFile = blockFile;
+    parser.simplifyTolerance = simplifyTolerance;
+    parser.borderLengths = borderLengths;
+
+    // skip generation if the state was last built from the same inputs
+    string manifestPath = write_path + ".manifest";
+    string manifest = parser.getManifest();
+
+    if (!force && boost::filesystem::exists(write_path) && ReadFile(manifestPath) == manifest) {
+        cout << write_path << " is up to date" << endl;
+        return 0;
+    }
+
+    // generate state from files
+    if (stream) {
+        // read geodata from disk one feature at a time
+        state = State::GenerateFromFile(parser);
+    }
+    else if (argc == 5) {
+        // map files into memory to be parsed in place
+        MappedFile precinct_geoJSON(parser.precinctFile);
+        MappedFile voter_data(parser.voterFile);
+        MappedFile district_geoJSON(parser.districtFile);
+        state = State::GenerateFromFile(precinct_geoJSON, voter_data, district_geoJSON, voter_heads, ids, parser);
+    }
+    else {
+        // map files into memory to be parsed in place
+        MappedFile precinct_geoJSON(parser.precinctFile);
+        MappedFile district_geoJSON(parser.districtFile);
+        state = State::GenerateFromFile(precinct_geoJSON, district_geoJSON, voter_heads, ids, parser);
     }
 
     state.toFile(write_path);
+    WriteFile(manifest, manifestPath);
     
     cout << "precincts:\t" << state.precincts.size() << endl;
     cout << "districts:\t" << state.districts.size() << endl;
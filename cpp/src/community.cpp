@@ -21,6 +21,7 @@
 
 
 #include <math.h>
+#include <cstring>
 #include <numeric>
 #include <iostream>
 #include <random>
@@ -82,7 +83,68 @@ void Community::addNode(Node& node) {
 }
 
 
+/**
+ * \brief Start of a binary communities file
+ *
+ * Followed by the int32 community of each node index, -1 for nodes
+ * in no community, then the null terminated precinct id of each
+ * node, which nodes are matched by on load.
+ */
+struct CommunitiesFileHeader {
+    char      magic[8];
+    uint32_t  version;
+    uint32_t  communities;
+    uint32_t  nodes;
+    uint32_t  reserved;
+};
+
+const char COMMUNITIES_FILE_MAGIC[8] = {'H', 'T', 'E', 'C', 'O', 'M', 'M', 'S'};
+const uint32_t COMMUNITIES_FILE_VERSION = 1;
+
+
 void hte::SaveCommunitiesToFile(Communities cs, std::string out) {
+    /*
+        @desc:
+            writes the community of each node, indexed by node id,
+            with the precinct id of each node so that it can be
+            loaded onto a graph with nodes in a different order
+
+        @params:
+            `Communities` cs: communities to save
+            `string` out: path to write to
+
+        @return: `void`
+    */
+
+    int nodes = 0;
+    for (Community& c : cs)
+        for (auto& pair : c.vertices) nodes = max(nodes, pair.first + 1);
+
+    vector<int32_t> assignment(nodes, -1);
+    vector<string> ids(nodes);
+
+    for (int i = 0; i < cs.size(); i++) {
+        for (auto& pair : cs[i].vertices) {
+            assignment[pair.first] = i;
+            ids[pair.first] = pair.second.precinct->shapeId;
+        }
+    }
+
+    CommunitiesFileHeader header;
+    memcpy(header.magic, COMMUNITIES_FILE_MAGIC, sizeof(header.magic));
+    header.version = COMMUNITIES_FILE_VERSION;
+    header.communities = cs.size();
+    header.nodes = nodes;
+    header.reserved = 0;
+
+    std::ofstream ofs(out, std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(assignment.data()), assignment.size() * sizeof(int32_t));
+    for (const string& id : ids) ofs.write(id.c_str(), id.size() + 1);
+}
+
+
+void hte::ExportCommunitiesToText(Communities cs, std::string out) {
     string file = "[";
     for (Community c : cs) {
         file += "[";
@@ -99,31 +161,7 @@ void hte::SaveCommunitiesToFile(Communities cs, std::string out) {
 
 
 Communities hte::LoadCommunitiesWithQuantification(std::string path, Graph& g, std::string tsv) {
-    string file = ReadFile(path);
-    file = file.substr(1, file.size() - 3);
-    vector<string> strs = Split(file, "[");
-    Communities communities(strs.size() - 1);
-    
-    for (int x = 0; x < strs.size(); x++) {
-        if (strs[x] != "" && strs[x] != " ") {
-            vector<string> s = Split(strs[x], ",");
-            for (int i = 0; i < s.size(); i++) {
-                if (s[i] != " " && s[i] != "") {
-                    string mod = s[i];
-                    mod = mod.substr(mod.find("'") + 1, mod.size() - mod.find("'") - 1);
-                    mod = mod.substr(0, mod.find("'"));
-
-                    for (int n = 0; n < g.vertices.size(); n++) {
-                        if ((g.vertices.begin() + n).value().precinct->shapeId == mod) {
-                            communities[x - 1].addNode((g.vertices.begin() + n).value());
-                            g.vertices[(g.vertices.begin() + n).key()].community = x - 1;
-                        }
-                    }
-                }
-            }
-        }
-    }
-
+    Communities communities = LoadCommunitiesFromFile(path, g);
     vector<vector<double> > quant = LoadQuantification(tsv);
     for (int i = 0; i < quant[0].size(); i++) {
         communities[i].quantification = quant[0][i];
@@ -156,32 +194,80 @@ vector<vector<double> > hte::LoadQuantification(std::string tsv) {
 
 
 Communities hte::LoadCommunitiesFromFile(std::string path, Graph& g) {
-    
+    /*
+        @desc:
+            reads communities saved by `SaveCommunitiesToFile`, or
+            exported by `ExportCommunitiesToText`, onto a graph. Saved
+            precinct ids are matched to nodes through a hash index
+
+        @params:
+            `string` path: path to the communities file
+            `Graph&` g: graph to assign communities on
+
+        @return: `Communities` the communities in the file
+    */
+
     string file = ReadFile(path);
-    file = file.substr(1, file.size() - 3);
-    vector<string> strs = Split(file, "[");
-    Communities communities(strs.size() - 1);
-    
-    for (int x = 0; x < strs.size(); x++) {
-        if (strs[x] != "" && strs[x] != " ") {
-            vector<string> s = Split(strs[x], ",");
-            for (int i = 0; i < s.size(); i++) {
-                if (s[i] != " " && s[i] != "") {
-                    string mod = s[i];
-                    mod = mod.substr(mod.find("'") + 1, mod.size() - mod.find("'") - 1);
-                    mod = mod.substr(0, mod.find("'"));
-
-                    for (int n = 0; n < g.vertices.size(); n++) {
-                        if ((g.vertices.begin() + n).value().precinct->shapeId == mod) {
-                            communities[x - 1].addNode((g.vertices.begin() + n).value());
-                            g.vertices[(g.vertices.begin() + n).key()].community = x - 1;
-                        }
-                    }
-                }
+    vector<string> ids;
+    vector<int> assignment;
+    int nCommunities = 0;
+
+    CommunitiesFileHeader header;
+    if (file.size() >= sizeof(header) && memcmp(file.data(), COMMUNITIES_FILE_MAGIC, sizeof(header.magic)) == 0) {
+        memcpy(&header, file.data(), sizeof(header));
+        size_t start = sizeof(header) + static_cast<size_t>(header.nodes) * sizeof(int32_t);
+        if (header.version > COMMUNITIES_FILE_VERSION || file.size() < start) throw Exceptions::CommunitiesFileInvalid();
+
+        assignment.resize(header.nodes);
+        memcpy(assignment.data(), file.data() + sizeof(header), header.nodes * sizeof(int32_t));
+
+        for (int i = 0; i < header.nodes; i++) {
+            size_t end = file.find('\0', start);
+            if (end == string::npos) throw Exceptions::CommunitiesFileInvalid();
+            ids.push_back(file.substr(start, end - start));
+            start = end + 1;
+        }
+
+        // -1 marks nodes in no community, anything else is damage
+        nCommunities = header.communities;
+        for (int community : assignment)
+            if (community < -1 || community >= nCommunities) throw Exceptions::CommunitiesFileInvalid();
+    }
+    else {
+        // exported text, in the format [['id', 'id'], ['id']]
+        int depth = 0;
+        for (size_t i = 0; i < file.size(); i++) {
+            if (file[i] == '[' && ++depth == 2) nCommunities++;
+            else if (file[i] == ']') depth--;
+            else if (file[i] == '\'' && depth == 2) {
+                size_t end = file.find('\'', i + 1);
+                if (end == string::npos) throw Exceptions::CommunitiesFileInvalid();
+
+                ids.push_back(file.substr(i + 1, end - i - 1));
+                assignment.push_back(nCommunities - 1);
+                i = end;
             }
         }
     }
 
+    // index nodes by precinct id, instead of searching for each id
+    // and clear their old communities, so nodes not in the file are in none
+    unordered_map<string, int> nodes;
+    nodes.reserve(g.vertices.size());
+    for (auto it = g.vertices.begin(); it != g.vertices.end(); ++it) {
+        nodes[it->second.precinct->shapeId] = it->first;
+        it.value().community = -1;
+    }
+
+    Communities communities(nCommunities);
+    for (int i = 0; i < ids.size(); i++) {
+        auto node = nodes.find(ids[i]);
+        if (assignment[i] == -1 || node == nodes.end()) continue;
+
+        communities[assignment[i]].addNode(g.vertices[node->second]);
+        g.vertices[node->second].community = assignment[i];
+    }
+
     return communities;
 }
 
@@ -241,8 +327,18 @@ double hte::GetPreciseCompactness(Community& community) {
 
     Point2dVec lp;
     vector<vector<double> > p;
-    for (Precinct pre : community.shape.precincts) {
-        lp.insert(lp.end(), pre.hull.border.begin(), pre.hull.border.end());
+
+    for (Precinct& pre : community.shape.precincts) {
+        // a stored convex hull bounds the same circle with fewer points
+        if (pre.attributes && !pre.attributes->convexHull.border.empty()) {
+            const Point2dVec& hull = pre.attributes->convexHull.border;
+            lp.insert(lp.end(), hull.begin(), hull.end());
+        }
+        else {
+            // read without keeping it, so attached states aren't copied
+            LinearRing hull = pre.getHull();
+            lp.insert(lp.end(), hull.border.begin(), hull.border.end());
+        }
     }
 
     p.reserve(lp.size());
@@ -322,7 +418,163 @@ vector<array<int, 2> > hte::GetAllExchanges(Graph& g, Communities& cs) {
 }
 
 
-void hte::GradientDescentOptimization(Graph& g, Communities& cs, double (*measure)(Communities&)) {
+vector<vector<int> > GetAssignment(Communities& cs) {
+    // node ids of each community, in the order they were added
+    vector<vector<int> > assignment(cs.size());
+    for (int i = 0; i < cs.size(); i++)
+        for (auto& pair : cs[i].vertices) assignment[i].push_back(pair.first);
+
+    return assignment;
+}
+
+
+size_t GraphHash(const Graph& g) {
+    // hash of every node id and the nodes it borders, in order
+    size_t h = g.vertices.size();
+    auto combine = [&h](int value) { h ^= std::hash<int>()(value) + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2); };
+
+    for (const auto& pair : g.vertices) {
+        combine(pair.first);
+        for (const Edge& edge : pair.second.edges) combine(edge[1]);
+    }
+
+    return h;
+}
+
+
+Communities RestoreAssignment(Graph& g, const vector<vector<int> >& assignment) {
+    // rebuilds communities from `GetAssignment`, adding nodes in the same order
+    int assigned = 0;
+    for (const vector<int>& community : assignment) {
+        for (int id : community) {
+            if (g.vertices.find(id) == g.vertices.end()) throw Exceptions::CheckpointMismatch();
+            assigned++;
+        }
+    }
+
+    // every node in exactly one community
+    if (assigned != g.vertices.size()) throw Exceptions::CheckpointMismatch();
+    for (auto& pair : g.vertices) pair.second.community = -1;
+
+    Communities cs(assignment.size());
+    for (int i = 0; i < assignment.size(); i++) {
+        for (int id : assignment[i]) {
+            if (g.vertices[id].community != -1) throw Exceptions::CheckpointMismatch();
+            cs[i].addNode(g.vertices[id]);
+            g.vertices[id].community = i;
+        }
+    }
+
+    return cs;
+}
+
+
+void hte::OptimizationCheckpoint::save(std::string path) const {
+    /*
+        @desc:
+            writes the checkpoint as text, with doubles at full
+            precision so that a resumed run continues identically
+
+        @params: `string` path: path to write to
+        @return: `void`
+    */
+
+    std::stringstream file;
+    file << std::setprecision(17);
+    file << "checkpoint 2\n";
+    file << "graph " << graph << "\n";
+    file << "epoch " << epoch << "\n";
+    file << "temperature " << temperature << "\n";
+    file << "measure " << measure << "\n";
+    file << "best_measure " << bestMeasure << "\n";
+    file << "rng " << rng << "\n";
+
+    for (const auto* assignment : {&communities, &best}) {
+        file << (assignment == &communities ? "communities " : "best ") << assignment->size() << "\n";
+        for (const vector<int>& community : *assignment) {
+            file << community.size();
+            for (int id : community) file << " " << id;
+            file << "\n";
+        }
+    }
+
+    WriteFile(file.str(), path + ".tmp");
+    std::rename((path + ".tmp").c_str(), path.c_str());
+}
+
+
+bool hte::OptimizationCheckpoint::load(std::string path) {
+    // read into a copy, so a damaged checkpoint changes nothing
+    std::ifstream file(path);
+    OptimizationCheckpoint loaded;
+    string key;
+    int version;
+    if (!(file >> key >> version) || key != "checkpoint" || version != 2) return false;
+
+    auto expect = [&](string name) { return (file >> key) && key == name; };
+    if (!(expect("graph") && file >> loaded.graph && expect("epoch") && file >> loaded.epoch
+        && expect("temperature") && file >> loaded.temperature && expect("measure") && file >> loaded.measure
+        && expect("best_measure") && file >> loaded.bestMeasure && expect("rng")))
+        return false;
+
+    // the rest of the line after one space, empty for gradient descent
+    file.ignore(1);
+    std::getline(file, loaded.rng);
+
+    for (auto* assignment : {&loaded.communities, &loaded.best}) {
+        int size;
+        if (!expect(assignment == &loaded.communities ? "communities" : "best") || !(file >> size) || size < 0) return false;
+        assignment->resize(size);
+
+        for (vector<int>& community : *assignment) {
+            int nodes;
+            if (!(file >> nodes) || nodes < 0) return false;
+            community.resize(nodes);
+            for (int& id : community) file >> id;
+        }
+    }
+
+    if (file.fail()) return false;
+    *this = loaded;
+    return true;
+}
+
+
+void hte::GradientDescentOptimization(Graph& g, Communities& cs, double (*measure)(Communities&), std::string checkpoint, int checkpointInterval) {
+    /*
+        @desc:
+            makes the exchange that most increases `measure` until no
+            exchange does. With a checkpoint path, the communities are
+            saved every `checkpointInterval` steps and when finished,
+            and a run with an existing checkpoint resumes from it
+
+        @params:
+            `Graph&` g: graph the communities are on
+            `Communities&` cs: communities to optimize
+            `double (*)(Communities&)` measure: measure to maximize
+            `string` checkpoint: path to save progress to, or empty
+            `int` checkpointInterval: steps between checkpoints
+
+        @return: `void`
+    */
+
+    if (checkpointInterval <= 0) throw Exceptions::CheckpointIntervalInvalid();
+
+    OptimizationCheckpoint progress;
+    if (!checkpoint.empty() && progress.load(checkpoint)) {
+        if (progress.graph != GraphHash(g)) throw Exceptions::CheckpointMismatch();
+        cs = RestoreAssignment(g, progress.communities);
+        if (VERBOSE) cout << "resuming from step " << progress.epoch << endl;
+    }
+
+    progress.graph = GraphHash(g);
+
+    auto save = [&](double m) {
+        progress.measure = progress.bestMeasure = m;
+        progress.communities = progress.best = GetAssignment(cs);
+        progress.save(checkpoint);
+    };
+
     while (true) {
         Graph before = g;
         array<int, 2> bestExchange;
@@ -345,21 +597,75 @@ void hte::GradientDescentOptimization(Graph& g, Communities& cs, double (*measur
 
         if (!canBeBetter) {
             cout << largestMeasure << endl;
+            if (!checkpoint.empty()) save(largestMeasure);
             break;
         }
 
         cout << largestMeasure << endl;
         ExchangePrecinct(g, cs, bestExchange[0], bestExchange[1]);
+
+        progress.epoch++;
+        if (!checkpoint.empty() && progress.epoch % checkpointInterval == 0) save(largestMeasure);
     }
 }
 
 
-void hte::SimulatedAnnealingOptimization(Graph& g, Communities& cs, double (*measure)(Community&)) {
+void hte::SimulatedAnnealingOptimization(Graph& g, Communities& cs, double (*measure)(Community&), std::string checkpoint, int checkpointInterval) {
+    /*
+        @desc:
+            anneals communities toward a lower average `measure`. With
+            a checkpoint path, the full state of the run is saved every
+            `checkpointInterval` epochs and when finished, and a run
+            with an existing checkpoint resumes from it
+
+        @params:
+            `Graph&` g: graph the communities are on
+            `Communities&` cs: communities to optimize
+            `double (*)(Community&)` measure: measure to minimize
+            `string` checkpoint: path to save progress to, or empty
+            `int` checkpointInterval: epochs between checkpoints
+
+        @return: `void`
+    */
+
     double Ec = Average(cs, measure);
     double Tmax = 30, Tmin = 0, T = Tmax;
     double Cool = 0.99976;
     int Epochs = 40000, Epoch = 0;
 
+    // seeded from rand(), but with state of its own that can be saved
+    std::mt19937 rng(rand());
+    auto random = [&](int end) { return (end == 0) ? 0 : static_cast<int>(rng() % end); };
+
+    if (checkpointInterval <= 0) throw Exceptions::CheckpointIntervalInvalid();
+
+    OptimizationCheckpoint progress;
+    progress.graph = GraphHash(g);
+    progress.bestMeasure = Ec;
+    progress.best = GetAssignment(cs);
+
+    if (!checkpoint.empty() && progress.load(checkpoint)) {
+        if (progress.graph != GraphHash(g)) throw Exceptions::CheckpointMismatch();
+        cs = RestoreAssignment(g, progress.communities);
+        Epoch = progress.epoch;
+        T = progress.temperature;
+        Ec = progress.measure;
+        std::stringstream(progress.rng) >> rng;
+        if (VERBOSE) cout << "resuming from epoch " << Epoch << endl;
+    }
+
+    auto save = [&]() {
+        std::stringstream state;
+        state << rng;
+
+        progress.epoch = Epoch;
+        progress.temperature = T;
+        progress.measure = Ec;
+        progress.rng = state.str();
+        progress.communities = GetAssignment(cs);
+        progress.save(checkpoint);
+    };
+
     while (Epoch < Epochs) {
         Epoch++;
         vector<array<int, 2> > allExchanges = GetAllExchanges(g, cs);
@@ -368,9 +674,9 @@ void hte::SimulatedAnnealingOptimization(Graph& g, Communities& cs, double (*mea
         int choice = -1;
 
         do {
-            int newChoice = RandInt(0, allExchanges.size());
+            int newChoice = random(allExchanges.size());
             while (choice == newChoice) {
-                newChoice = RandInt(0, allExchanges.size());
+                newChoice = random(allExchanges.size());
             }
             choice = newChoice;
             chosenExchange = allExchanges[newChoice];
@@ -378,11 +684,16 @@ void hte::SimulatedAnnealingOptimization(Graph& g, Communities& cs, double (*mea
         } while (!ExchangePrecinct(g, cs, chosenExchange[0], chosenExchange[1]));
 
         double En = Average(cs, measure);
-        double x = RandUnitInterval();
+        double x = static_cast<double>(random(100000)) / 100000.0;
 
         if (En < Ec) {
             Ec = En;
             cout << T << "\t" << Ec << endl;
+
+            if (Ec < progress.bestMeasure) {
+                progress.bestMeasure = Ec;
+                progress.best = GetAssignment(cs);
+            }
         }
         else if ((T / Tmax) > x) {
             cout << T << "\t" << Ec << endl;
@@ -393,7 +704,10 @@ void hte::SimulatedAnnealingOptimization(Graph& g, Communities& cs, double (*mea
         }
 
         T *= Cool;
+        if (!checkpoint.empty() && Epoch % checkpointInterval == 0) save();
     }
+
+    if (!checkpoint.empty()) save();
 }
 
 
@@ -11,6 +11,8 @@
 #include <iostream>
 #include <chrono>
 #include <random>
+#include <atomic>
+#include <thread>
 #include <math.h>
 #include "../include/hte.h"
 
@@ -149,6 +151,255 @@ BoostPolygon hte::RingToBoostPoly(LinearRing shape) {
 }
 
 
+/*
+    Ring kernels for area, perimeter and bounds. Points are stored
+    interleaved, so the AVX2 versions load two points to a register
+    and split the x and y lanes in registers, which is cheaper than
+    copying each ring into separate x and y arrays first. Both
+    versions keep four partial sums, one per lane, added in the same
+    order. Coordinate differences under 2^26 make every product
+    exact as a double, so for any such ring the AVX2 and scalar
+    versions give identical results. Larger rings use the scalar
+    versions, which multiply as integers.
+*/
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    #define AVX2_KERNELS
+    #include <immintrin.h>
+#endif
+
+static_assert(sizeof(Point2d) == 2 * sizeof(long), "kernels read points as pairs of longs");
+
+// largest coordinate difference whose products are exact as doubles
+const long KERNEL_LIMIT = 1L << 26;
+
+
+static double ShoelaceTerm(const Point2d* p, int i, int j) {
+    // cross product of two points, relative to the first point
+    long xi = p[i].x - p[0].x, yi = p[i].y - p[0].y;
+    long xj = p[j].x - p[0].x, yj = p[j].y - p[0].y;
+    return static_cast<double>(xi * yj - yi * xj);
+}
+
+
+static double EdgeLength(const Point2d* p, int i, int j) {
+    double dx = static_cast<double>(p[j].x - p[i].x);
+    double dy = static_cast<double>(p[j].y - p[i].y);
+    return sqrt(dx * dx + dy * dy);
+}
+
+
+static double ShoelaceSumScalar(const Point2d* p, int n) {
+    // lanes hold edges {i, i + 2, i + 1, i + 3}, as in the AVX2 version
+    double lanes[4] = {0, 0, 0, 0};
+    int i = 0;
+
+    for (; i + 5 <= n; i += 4) {
+        lanes[0] += ShoelaceTerm(p, i, i + 1);
+        lanes[1] += ShoelaceTerm(p, i + 2, i + 3);
+        lanes[2] += ShoelaceTerm(p, i + 1, i + 2);
+        lanes[3] += ShoelaceTerm(p, i + 3, i + 4);
+    }
+
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += ShoelaceTerm(p, i, (i + 1 == n) ? 0 : i + 1);
+    return sum;
+}
+
+
+static double PerimeterScalar(const Point2d* p, int n) {
+    double lanes[4] = {0, 0, 0, 0};
+    int i = 0;
+
+    for (; i + 5 <= n; i += 4) {
+        lanes[0] += EdgeLength(p, i, i + 1);
+        lanes[1] += EdgeLength(p, i + 2, i + 3);
+        lanes[2] += EdgeLength(p, i + 1, i + 2);
+        lanes[3] += EdgeLength(p, i + 3, i + 4);
+    }
+
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += EdgeLength(p, i, (i + 1 == n) ? 0 : i + 1);
+    return sum;
+}
+
+
+static BoundingBox BoundsScalar(const Point2d* p, int n) {
+    long top = p[0].y, bottom = p[0].y, left = p[0].x, right = p[0].x;
+    for (int i = 1; i < n; i++) {
+        top = max(top, p[i].y);
+        bottom = min(bottom, p[i].y);
+        left = min(left, p[i].x);
+        right = max(right, p[i].x);
+    }
+
+    return {top, bottom, left, right};
+}
+
+
+bool hte::HasVectorKernels() {
+    #ifdef AVX2_KERNELS
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    #else
+        return false;
+    #endif
+}
+
+
+#ifdef AVX2_KERNELS
+
+
+__attribute__((target("avx2")))
+static inline __m256i LoadPoints(const Point2d* p) {
+    // {x, y} of two points
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256d ToDouble(__m256i v) {
+    // exact for values under 2^51, by adding them to the mantissa of 2^52 + 2^51
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(v, _mm256_castpd_si256(magic))), magic);
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i OutOfRange(__m256i v) {
+    // lanes at or beyond the kernel limit, either side of zero
+    const __m256i high = _mm256_set1_epi64x(KERNEL_LIMIT - 1), low = _mm256_set1_epi64x(-KERNEL_LIMIT + 1);
+    return _mm256_or_si256(_mm256_cmpgt_epi64(v, high), _mm256_cmpgt_epi64(low, v));
+}
+
+
+__attribute__((target("avx2")))
+static bool ShoelaceSumAvx2(const Point2d* p, int n, double& sum) {
+    // returns false, leaving `sum` unset, if the ring is too large
+    const __m256i origin = _mm256_set_epi64x(p[0].y, p[0].x, p[0].y, p[0].x);
+    __m256d lanes = _mm256_setzero_pd();
+    __m256i range = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 5 <= n; i += 4) {
+        __m256i a = _mm256_sub_epi64(LoadPoints(p + i), origin);      // points i, i + 1
+        __m256i b = _mm256_sub_epi64(LoadPoints(p + i + 1), origin);  // points i + 1, i + 2
+        __m256i c = _mm256_sub_epi64(LoadPoints(p + i + 2), origin);  // points i + 2, i + 3
+        __m256i d = _mm256_sub_epi64(LoadPoints(p + i + 3), origin);  // points i + 3, i + 4
+        range = _mm256_or_si256(range, _mm256_or_si256(OutOfRange(a), OutOfRange(c)));
+        range = _mm256_or_si256(range, OutOfRange(d));
+
+        // {x0 * y1, y0 * x1} for each edge, then their differences
+        __m256d first = _mm256_mul_pd(ToDouble(a), _mm256_permute_pd(ToDouble(b), 0b0101));
+        __m256d second = _mm256_mul_pd(ToDouble(c), _mm256_permute_pd(ToDouble(d), 0b0101));
+        lanes = _mm256_add_pd(lanes, _mm256_hsub_pd(first, second));
+    }
+
+    if (!_mm256_testz_si256(range, range)) return false;
+
+    double partial[4];
+    _mm256_storeu_pd(partial, lanes);
+    sum = (partial[0] + partial[1]) + (partial[2] + partial[3]);
+    for (; i < n; i++) sum += ShoelaceTerm(p, i, (i + 1 == n) ? 0 : i + 1);
+    return true;
+}
+
+
+__attribute__((target("avx2")))
+static bool PerimeterAvx2(const Point2d* p, int n, double& sum) {
+    // returns false, leaving `sum` unset, if an edge is too long
+    __m256d lanes = _mm256_setzero_pd();
+    __m256i range = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 5 <= n; i += 4) {
+        __m256i a = _mm256_sub_epi64(LoadPoints(p + i + 1), LoadPoints(p + i));      // edges i, i + 1
+        __m256i b = _mm256_sub_epi64(LoadPoints(p + i + 3), LoadPoints(p + i + 2));  // edges i + 2, i + 3
+        range = _mm256_or_si256(range, _mm256_or_si256(OutOfRange(a), OutOfRange(b)));
+
+        __m256d da = ToDouble(a), db = ToDouble(b);
+        __m256d squares = _mm256_hadd_pd(_mm256_mul_pd(da, da), _mm256_mul_pd(db, db));
+        lanes = _mm256_add_pd(lanes, _mm256_sqrt_pd(squares));
+    }
+
+    if (!_mm256_testz_si256(range, range)) return false;
+
+    double partial[4];
+    _mm256_storeu_pd(partial, lanes);
+    sum = (partial[0] + partial[1]) + (partial[2] + partial[3]);
+    for (; i < n; i++) sum += EdgeLength(p, i, (i + 1 == n) ? 0 : i + 1);
+    return true;
+}
+
+
+__attribute__((target("avx2")))
+static BoundingBox BoundsAvx2(const Point2d* p, int n) {
+    __m256i low = _mm256_set_epi64x(p[0].y, p[0].x, p[0].y, p[0].x);
+    __m256i high = low;
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m256i v = LoadPoints(p + i);
+        low = _mm256_blendv_epi8(low, v, _mm256_cmpgt_epi64(low, v));
+        high = _mm256_blendv_epi8(high, v, _mm256_cmpgt_epi64(v, high));
+    }
+
+    long lows[4], highs[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lows), low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(highs), high);
+
+    BoundingBox box = {max(highs[1], highs[3]), min(lows[1], lows[3]), min(lows[0], lows[2]), max(highs[0], highs[2])};
+    if (i < n) {
+        box[0] = max(box[0], p[i].y);
+        box[1] = min(box[1], p[i].y);
+        box[2] = min(box[2], p[i].x);
+        box[3] = max(box[3], p[i].x);
+    }
+
+    return box;
+}
+
+#endif
+
+
+double hte::GetShoelaceSum(const Point2dVec& ring, bool vectorize) {
+    // twice the signed area of a ring, see the kernels above
+    if (ring.empty()) return 0;
+
+    #ifdef AVX2_KERNELS
+        double sum;
+        if (vectorize && HasVectorKernels() && ShoelaceSumAvx2(ring.data(), ring.size(), sum)) return sum;
+    #endif
+
+    return ShoelaceSumScalar(ring.data(), ring.size());
+}
+
+
+double hte::GetRingPerimeter(const Point2dVec& ring, bool vectorize) {
+    // sum of the lengths of a ring's edges, including the closing edge
+    if (ring.empty()) return 0;
+
+    #ifdef AVX2_KERNELS
+        double sum;
+        if (vectorize && HasVectorKernels() && PerimeterAvx2(ring.data(), ring.size(), sum)) return sum;
+    #endif
+
+    return PerimeterScalar(ring.data(), ring.size());
+}
+
+
+BoundingBox hte::GetRingBoundingBox(const Point2dVec& ring, bool vectorize) {
+    // extremes of a ring, as {top, bottom, left, right}
+    if (ring.empty()) return {0, 0, 0, 0};
+
+    #ifdef AVX2_KERNELS
+        if (vectorize && HasVectorKernels()) return BoundsAvx2(ring.data(), ring.size());
+    #endif
+
+    return BoundsScalar(ring.data(), ring.size());
+}
+
+
 double hte::LinearRing::getSignedArea() {
     /*
         @desc:
@@ -160,17 +411,7 @@ double hte::LinearRing::getSignedArea() {
         @return: area of linear ring as a double
     */
 
-    double area = 0;
-
-    for ( int i = 0; i < border.size(); i++ ) {
-        int j;
-        if (i == border.size() - 1) j = 0;
-        else j = i + 1;
-
-        area += (border[i].x * border[j].y) - (border[i].y * border[j].x);
-    }
-
-    return area / 2.0;
+    return GetShoelaceSum(border) / 2.0;
 }
 
 
@@ -181,11 +422,7 @@ double hte::LinearRing::getPerimeter() {
         @return: `double` perimeter
     */
 
-    double t = 0;
-    for (Segment s : getSegments())
-        t += GetDistance(s);    
-
-    return t;
+    return GetRingPerimeter(border);
 }
 
 
@@ -266,9 +503,10 @@ double hte::Polygon::getSignedArea() {
 
 
 double hte::PrecinctGroup::getArea() {
+    // precincts read their rings only if they have no stored area
     double sum = 0;
     
-    for (Precinct p : precincts)
+    for (Precinct& p : precincts)
         sum += abs(p.getSignedArea());
     return sum;
 }
@@ -325,7 +563,7 @@ double hte::MultiPolygon::getPerimeter() {
 }
 
 
-bool hte::GetBordering(Polygon s0, Polygon s1) {
+bool hte::GetBordering(const Polygon& s0, const Polygon& s1) {
     /*
         @desc: gets whether or not two shapes touch each other
         @params: `Polygon` s0, `Polygon` s1: shapes to check bordering
@@ -377,7 +615,7 @@ bool hte::GetPointInRing(hte::Point2d coord, hte::LinearRing lr) {
 }
 
 
-bool hte::GetInside(hte::LinearRing s0, hte::LinearRing s1) {
+bool hte::GetInside(const hte::LinearRing& s0, const hte::LinearRing& s1) {
     /*
         @desc:
             gets whether or not s0 is inside of 
@@ -390,8 +628,14 @@ bool hte::GetInside(hte::LinearRing s0, hte::LinearRing s1) {
         @return: `bool` `s0` inside `s1`
     */
 
-    for (Point2d c : s0.border)
-        if (!GetPointInRing(c, s1)) return false;
+    // convert the container once for every point check,
+    // closing it for the PIP problem
+    ClipperLib::Path path = RingToPath(s1);
+    if (!path.empty() && path.front() != path.back())
+        path.push_back(path.front());
+
+    for (const Point2d& c : s0.border)
+        if (ClipperLib::PointInPolygon(ClipperLib::IntPoint(c.x, c.y), path) == 0) return false;
 
     return true;
 }
@@ -504,6 +748,12 @@ ClipperLib::Paths hte::PolygonToPaths(hte::Polygon shape) {
 }
 
 
+BoostBox hte::BoundingBoxToBoostBox(BoundingBox box) {
+    // converts a {top, bottom, left, right} box into boost corners
+    return BoostBox(BoostPoint2d(box[2], box[1]), BoostPoint2d(box[3], box[0]));
+}
+
+
 MultiPolygon hte::PathsToMultiPolygon(ClipperLib::Paths paths) {
     /*
         @desc: 
@@ -578,40 +828,94 @@ bool hte::GetPointInCircle(hte::Point2d center, double radius, hte::Point2d poin
 
 
 
-BoundingBox hte::LinearRing::getBoundingBox() {
-    int top = border[0].y, 
-    bottom = border[0].y, 
-    left = border[0].x, 
-    right = border[0].x;
-
-    // loop through and find actual corner using ternary assignment
-    for (hte::Point2d coord : border) {
-        if (coord.y > top) top = coord.y;
-        if (coord.y < bottom) bottom = coord.y;
-        if (coord.x < left) left = coord.x;
-        if (coord.x > right) right = coord.x;
-    }
+void hte::State::computeAttributes(int threads) {
+    /*
+        @desc:
+            computes the centroid, area, perimeter, bounding box
+            and convex hull of every precinct. Precincts are
+            independent, so workers take them in turn from a
+            shared counter
 
-    return {top, bottom, left, right}; // return bounding box
+        @params: `int` threads: number of workers, or 0 for one per core
+        @return: void
+    */
+
+    attributes.assign(precincts.size(), PrecinctAttributes());
+    atomic<int> next(0);
+
+    // shared arcs are measured once, rather than by each ring
+    vector<PrecinctAttributes> measured;
+    if (topology.precinctRings.size() == precincts.size()) measured = topology.getAttributes();
+
+    auto compute = [&]() {
+        for (int i = next++; i < precincts.size(); i = next++) {
+            Precinct& precinct = precincts[i];
+            PrecinctAttributes& attr = attributes[i];
+            precinct.attributes.reset();
+            BoostPolygon shape = RingToBoostPoly(precinct.hull);
+
+            BoostPoint2d center;
+            boost::geometry::centroid(shape, center);
+            precinct.hull.centroid = {center.x(), center.y()};
+
+            BoostPolygon hull;
+            boost::geometry::convex_hull(shape, hull);
+            for (const BoostPoint2d& point : hull.outer())
+                attr.convexHull.border.push_back({point.x(), point.y()});
+
+            attr.centroid = precinct.hull.centroid;
+            if (!measured.empty()) {
+                attr.area = measured[i].area;
+                attr.perimeter = measured[i].perimeter;
+                attr.boundingBox = measured[i].boundingBox;
+                continue;
+            }
+
+            attr.area = precinct.getSignedArea();
+            attr.perimeter = precinct.getPerimeter();
+            attr.boundingBox = precinct.getBoundingBox();
+        }
+    };
+
+    int nThreads = threads > 0 ? threads : max(1, static_cast<int>(thread::hardware_concurrency()));
+    vector<std::thread> workers;
+    for (int t = 1; t < nThreads; t++) workers.emplace_back(compute);
+    compute();
+    for (std::thread& worker : workers) worker.join();
+
+    applyAttributes();
 }
 
 
-BoundingBox hte::Polygon::getBoundingBox() {
-    // set dummy extremes
-    int top = hull.border[0].y, 
-        bottom = hull.border[0].y, 
-        left = hull.border[0].x, 
-        right = hull.border[0].x;
-
-    // loop through and find actual corner using ternary assignment
-    for (hte::Point2d coord : hull.border) {
-        if (coord.y > top) top = coord.y;
-        if (coord.y < bottom) bottom = coord.y;
-        if (coord.x < left) left = coord.x;
-        if (coord.x > right) right = coord.x;
+void hte::State::applyAttributes() {
+    /*
+        @desc:
+            gives each precinct a copy of its derived geometry, which
+            its area, perimeter and bounding box are then read from.
+            Each copy is shared by the precinct's copies in communities
+
+        @params: none
+        @return: void
+    */
+
+    if (attributes.size() != precincts.size()) return;
+
+    for (int i = 0; i < precincts.size(); i++) {
+        precincts[i].attributes = make_shared<const PrecinctAttributes>(attributes[i]);
+        precincts[i].hull.centroid = attributes[i].centroid;
     }
+}
 
-    return {top, bottom, left, right}; // return bounding box
+
+BoundingBox hte::LinearRing::getBoundingBox() {
+    // extremes of the border, as {top, bottom, left, right}
+    return GetRingBoundingBox(border);
+}
+
+
+BoundingBox hte::Polygon::getBoundingBox() {
+    // bounds of the hull, which contains any holes
+    return hull.getBoundingBox();
 }
 
 
@@ -639,21 +943,17 @@ BoundingBox hte::MultiPolygon::getBoundingBox() {
 BoundingBox hte::PrecinctGroup::getBoundingBox() {
     // set dummy extremes
     if (precincts.size() != 0) {
-        int top = precincts[0].hull.border[0].y, 
-            bottom = precincts[0].hull.border[0].y, 
-            left = precincts[0].hull.border[0].x, 
-            right = precincts[0].hull.border[0].x;
-
-        for (Precinct p : precincts) {
-            // loop through and find actual corner using ternary assignment
-            for (hte::Point2d coord : p.hull.border) {
-                if (coord.y > top) top = coord.y;
-                if (coord.y < bottom) bottom = coord.y;
-                if (coord.x < left) left = coord.x;
-                if (coord.x > right) right = coord.x;
-            }
+        BoundingBox bounds = precincts[0].getBoundingBox();
+
+        for (Precinct& p : precincts) {
+            // combine stored bounds, or those of the hull
+            BoundingBox box = p.getBoundingBox();
+            if (box[0] > bounds[0]) bounds[0] = box[0];
+            if (box[1] < bounds[1]) bounds[1] = box[1];
+            if (box[2] < bounds[2]) bounds[2] = box[2];
+            if (box[3] > bounds[3]) bounds[3] = box[3];
         }
-        return {top, bottom, left, right}; // return bounding box
+        return bounds; // return bounding box
     }
     else {
         cout  << "lol no precincts here bro" << endl;
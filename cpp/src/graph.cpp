@@ -16,6 +16,37 @@ using namespace hte;
 using namespace std;
 
 
+Graph CensusBlocks::getGraph() const {
+    /*
+        @desc:
+            Expands the compressed rows of bordering blocks into
+            a graph, with a node for each block in index order
+
+        @params: none
+        @return: `Graph` the block adjacency graph
+    */
+
+    Graph graph;
+
+    for (int i = 0; i < size(); i++) {
+        Node node(nullptr);
+        node.id = i;
+
+        for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+            node.edges.push_back({i, neighbors[k]});
+            if (i < neighbors[k]) {
+                graph.edges.push_back({i, neighbors[k]});
+                graph.borderLengths[{i, neighbors[k]}] = borderLengths[k];
+            }
+        }
+
+        graph.vertices[i] = node;
+    }
+
+    return graph;
+}
+
+
 void Graph::removeNode(int id) {
     removeEdgesTo(id);
     vertices.erase(id);
@@ -28,8 +28,8 @@ Outline hte::ToOutline(LinearRing r) {
 
 vector<Outline> hte::ToOutline(State state) {
     vector<Outline> outlines;
-    for (Precinct p : state.precincts) {
-        Outline o(p.hull);
+    for (Precinct& p : state.precincts) {
+        Outline o(p.getHull());
         double ratio = 0.5;
         if (!(p.voterData[PoliticalParty::Democrat] == 0 && p.voterData[PoliticalParty::Republican] == 0)) {
             ratio = static_cast<double>(p.voterData[PoliticalParty::Democrat]) / static_cast<double>(p.voterData[PoliticalParty::Democrat] + p.voterData[PoliticalParty::Republican]);
@@ -100,7 +100,8 @@ vector<Outline> hte::ToOutline(Communities& communities) {
 
     for (int i = 0; i < communities.size(); i++) {
         for (auto& j : communities[i].vertices) {
-            Outline o(j.second.precinct->hull);
+            // lazily loaded precincts are drawn without keeping their rings
+            Outline o(j.second.precinct->getHull());
             o.style().fill(colors[i]).outline(colors[i]).thickness(1);
             outlines.push_back(o);
         }
@@ -116,7 +117,9 @@ vector<OutlineGroup> hte::ToOutlineGroup(Communities& communities) {
 
     for (int i = 0; i < communities.size(); i++) {
         OutlineGroup og;
+        // read rings into the copies, leaving the community's precincts without them
         vector<Precinct> precincts = communities[i].shape.precincts;
+        for (Precinct& precinct : precincts) precinct.loadGeometry();
         vector<Polygon> polys;
         polys.insert(polys.end(), precincts.begin(), precincts.end());
 
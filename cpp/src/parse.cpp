@@ -12,11 +12,19 @@
 #include <numeric>       // include std::iota
 #include <iomanip>       // setprecision for debug
 #include <iterator>      // for find algorithms
+#include <functional>    // std::function for feature callbacks
+#include <cstdio>        // FILE for streaming reads
+#include <charconv>      // std::from_chars for vote counts
+#include <string_view>   // views into mapped and read files
+#include <thread>        // worker threads for adjacency checks
+#include <atomic>        // shared work counter for workers
+#include <set>           // edges with measured borders
 
 // for the rapidjson parser
 #include "../lib/rapidjson/include/rapidjson/document.h"
-#include "../lib/rapidjson/include/rapidjson/writer.h"
-#include "../lib/rapidjson/include/rapidjson/stringbuffer.h"
+#include "../lib/rapidjson/include/rapidjson/reader.h"
+#include "../lib/rapidjson/include/rapidjson/filereadstream.h"
+#include "../lib/rapidjson/include/rapidjson/error/en.h"
 #include "../include/hte.h"
 
 #define VERBOSE 1
@@ -32,7 +40,6 @@ const long int COORD_SCALER = pow(2, 18);
 // identifications for files
 map<IdType, string> idHeaders;
 map<PoliticalParty, string> electionHeaders;
-const vector<string> nonPrecinctIds = {"9999", "WV", "ZZZZZ", "LAKE", "WWWWWW", "1808904150", "1812700460", "39095123ZZZ", "39043043ACN", "39123123ZZZ", "39043043ZZZ", "39093093999", "39035007999", "3908500799", "3900700799"};
 
 
 class NodePair {
@@ -47,64 +54,123 @@ class NodePair {
 };
 
 
-vector<vector<string> > hte::parseSV(string tsv, string delimiter) {
+vector<vector<string> > hte::parseSV(string_view tsv, string_view delimiter) {
     /*
         @desc:
             takes a tsv file as string, finds two
             dimensional array of cells and rows
 
         @params:
-            `string` tsv: A delimiter separated file
-            `string` delimiter: A delimiter to split by
+            `string_view` tsv: A delimiter separated file
+            `string_view` delimiter: A delimiter to split by
         
         @return: `vector<vector<string> >` parsed array of data
-
-        @warn:
-            for some reason this will glitch
-            when the id's are at the end of the line
     */
 
-    stringstream file(tsv);
-    string line;
     vector<vector<string> > data;
+    size_t lineStart = 0;
+
+    while (lineStart < tsv.size()) {
+        size_t lineEnd = tsv.find('\n', lineStart);
+        if (lineEnd == string_view::npos) lineEnd = tsv.size();
+        string_view line = tsv.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
 
-    while (getline(file, line)) {
         vector<string> row;
-        size_t pos = 0;
+        size_t pos = 0, next;
 
-        while ((pos = line.find(delimiter)) != string::npos) {
-            row.push_back(line.substr(0, pos));
-            line.erase(0, pos + delimiter.length());
+        while ((next = line.find(delimiter, pos)) != string_view::npos) {
+            row.emplace_back(line.substr(pos, next - pos));
+            pos = next + delimiter.length();
         }
 
-        row.push_back(line);
-        data.push_back(row);
+        row.emplace_back(line.substr(pos));
+        data.push_back(move(row));
     }
 
     return data;
 }
 
 
-map<string, map<PoliticalParty, int> > parseVoterData(string voterData) {
+bool ParseVoteCount(string_view cell, int& votes) {
+    /*
+        @desc:
+            reads the integer part of a numeric cell, accepting
+            the same forms as `IsNumber` (optional sign, digits,
+            optional decimal part)
+
+        @params:
+            `string_view` cell: a single cell of election data
+            `int&` votes: set to the truncated value of the cell
+
+        @return: `bool` whether the cell held a number
+    */
+
+    if (!IsNumber(cell)) return false;
+    if (cell[0] == '+') cell.remove_prefix(1);
+
+    return from_chars(cell.data(), cell.data() + cell.size(), votes).ec == errc();
+}
+
+
+map<PoliticalParty, int> VoterTable::getVotes(int row) const {
+    /*
+        @desc: gathers the votes of a row, leaving out empty cells
+        @params: `int` row: index of the row
+        @return: `map<PoliticalParty, int>` votes for each party with data
+    */
+
+    map<PoliticalParty, int> rowVotes;
+    for (size_t p = 0; p < parties.size(); p++) {
+        if (filled[p][row]) rowVotes[parties[p]] = votes[p][row];
+    }
+
+    return rowVotes;
+}
+
+
+VoterTable parseVoterData(string_view voterData) {
     /*
         @desc:
-            from a string in the specified format,
-            creates a map with the key of the precinct
-            name and vector as `"name": {dem_vote, rep vote}`
+            from a string in the specified format, reads
+            the id of each precinct and its votes. The file
+            is tokenized in a single pass, with votes read
+            into an integer column for each party
 
-        @params: `string` voter_data: tab separated voting file
-        @return: `map<string, array<int, 2>>` parsed data
+        @params: `string_view` voter_data: tab separated voting file
+        @return: `VoterTable` parsed data
     */
 
-    vector<vector<string> > dataList // two dimensional
-        = parseSV(voterData, "\t"); // array of voter data
+    size_t lineStart = 0;
+    vector<string_view> cells; // cells of the current row, reused
+
+    // splits the next line of the file into `cells`
+    auto nextRow = [&]() {
+        size_t lineEnd = voterData.find('\n', lineStart);
+        if (lineEnd == string_view::npos) lineEnd = voterData.size();
+        string_view line = voterData.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        cells.clear();
+        if (line.empty()) return;
+
+        size_t pos = 0, next;
+        while ((next = line.find('\t', pos)) != string_view::npos) {
+            cells.push_back(line.substr(pos, next - pos));
+            pos = next + 1;
+        }
+
+        cells.push_back(line.substr(pos));
+    };
 
     int precinctIdCol = -1; // the column index that holds precinct id's
     map<PoliticalParty, int> electionCols;
 
-    for (int i = 0; i < dataList[0].size(); i++) {
+    nextRow();
+    for (int i = 0; i < cells.size(); i++) {
         // val holds header string
-        string val = dataList[0][i];
+        string_view val = cells[i];
         if (val == idHeaders[IdType::ELECTIONID])
             precinctIdCol = i;
 
@@ -115,105 +181,130 @@ map<string, map<PoliticalParty, int> > parseVoterData(string voterData) {
         }
     }
 
-    map<string, map<PoliticalParty, int> > parsedData;
+    // precinct ids and a vote column for each party, with one entry per row
+    vector<pair<PoliticalParty, int> > partyCols(electionCols.begin(), electionCols.end());
+    VoterTable table;
+    table.votes.resize(partyCols.size());
+    table.filled.resize(partyCols.size());
+    for (auto& col : partyCols) table.parties.push_back(col.first);
 
     // iterate over each precinct, skipping header
-    for (int x = 1; x < dataList.size(); x++) {
-        string id;
+    while (lineStart < voterData.size()) {
+        nextRow();
+        if (cells.empty()) continue;
+
+        string_view id = precinctIdCol >= 0 && precinctIdCol < cells.size() ? cells[precinctIdCol] : "";
 
         // remove quotes from string
-        if (dataList[x][precinctIdCol].substr(0, 1) == "\"")
-            id = Split(dataList[x][precinctIdCol], "\"")[1];
-        else id = dataList[x][precinctIdCol];
-                
-        map<PoliticalParty, int> precinctVoterData;
+        if (!id.empty() && id[0] == '"') {
+            id.remove_prefix(1);
+            id = id.substr(0, id.find('"'));
+        }
 
-        // get the right voter columns, add to party total
-        for (auto& partyCol : electionCols) {
-            string d = dataList[x][partyCol.second];
+        table.ids.emplace_back(id);
 
-            if (IsNumber(d)) precinctVoterData[partyCol.first] += stoi(d);
-        }
+        // get the right voter columns
+        for (size_t p = 0; p < partyCols.size(); p++) {
+            int votesInCell = 0;
+            bool isNumber = partyCols[p].second < cells.size()
+                && ParseVoteCount(cells[partyCols[p].second], votesInCell);
 
-        parsedData[id] = precinctVoterData;
-        // set the voter data of the precinct in the map
+            table.votes[p].push_back(votesInCell);
+            table.filled[p].push_back(isNumber);
+        }
     }
 
-    return parsedData; // return the filled map
+    // later rows of a repeated id replace earlier ones
+    table.rows.reserve(table.ids.size());
+    for (int x = 0; x < table.ids.size(); x++) table.rows[table.ids[x]] = x;
+
+    return table;
 }
 
 
-Polygon hte::StringToPoly(string str, bool texasCoord) {
+void BuildRing(const Value& coords, bool texasCoord, LinearRing& ring) {
     /*
-        @desc: takes a json array string and returns a parsed shape object
-        @params: `string` str: data to be parsed
-        @return: `Polygon` parsed shape
-
-        @warn:
-            this function is so screwed up right now
-            it takes stringified JSON as input and then 
-            CONVERTS IT RIGHT BACK TO JSON WTH
+        @desc:
+            fills the border of `ring` from a geojson array of
+            positions, closing the ring if it isn't already closed
 
-            but I guess speed is really not important for
-            a one time operation so not going to change this
+        @params:
+            `const Value&` coords: array of [x, y] positions
+            `bool` texasCoord: whether coordinates are already scaled
+            `LinearRing&` ring: ring to fill
 
-            oohhhh yeah i forgot how to deduce types so this
-            monstrosity happened
+        @return: void
     */
 
-    Polygon v;
-    Document mp;
-    mp.Parse(str.c_str());
+    double scale = texasCoord ? 1.0 : static_cast<double>(COORD_SCALER);
+    ring.border.reserve(ring.border.size() + coords.Size() + 1);
 
-    LinearRing hull;
-    for (int i = 0; i < mp[0].Size(); i++) {
-        double x, y;
-        if (!texasCoord) {
-            x = mp[0][i][0].GetDouble() * COORD_SCALER;
-            y = mp[0][i][1].GetDouble() * COORD_SCALER;
-        }
-        else {
-            x = mp[0][i][0].GetDouble();
-            y = mp[0][i][1].GetDouble();
-        }
+    for (SizeType i = 0; i < coords.Size(); i++) {
+        ring.border.push_back({
+            static_cast<long>(coords[i][0].GetDouble() * scale),
+            static_cast<long>(coords[i][1].GetDouble() * scale)
+        });
+    }
 
-        hull.border.push_back({static_cast<long>(x), static_cast<long>(y)});
+    // make sure that the coordinates form a complete LinearRing
+    if (coords.Size() > 0 && (coords[0][0] != coords[coords.Size() - 1][0] ||
+        coords[0][1] != coords[coords.Size() - 1][1])) {
+        ring.border.push_back(ring.border[0]);
     }
+}
+
+
+void BuildPolygon(const Value& coords, bool texasCoord, Polygon& polygon) {
+    /*
+        @desc: fills the hull and holes of `polygon` from geojson polygon coordinates
+        @params:
+            `const Value&` coords: array of rings, the first being the hull
+            `bool` texasCoord: whether coordinates are already scaled
+            `Polygon&` polygon: polygon to fill
+
+        @return: void
+    */
 
-    // make sure that hole forms a complete LinearRing
-    if (mp[0][0][0] != mp[0][mp[0].Size() - 1][0] || 
-        mp[0][0][1] != mp[0][mp[0].Size() - 1][1]) {       
-        hull.border.push_back(hull.border[0]);
+    if (coords.Size() == 0) return;
+    BuildRing(coords[0], texasCoord, polygon.hull);
+
+    polygon.holes.resize(coords.Size() - 1);
+    for (SizeType i = 1; i < coords.Size(); i++) {
+        BuildRing(coords[i], texasCoord, polygon.holes[i - 1]);
     }
+}
 
-    v.hull = hull;
 
-    for (int i = 1; i < mp.Size(); i++) {
-        LinearRing hole;
-        for (int j = 0; j < mp[i].Size(); j++) {
-            if (!texasCoord) {
-                hole.border.push_back({
-                    static_cast<long>(mp[i][j][0].GetDouble() * COORD_SCALER),
-                    static_cast<long>(mp[i][j][1].GetDouble() * COORD_SCALER)
-                });
-            }
-            else {
-                hole.border.push_back({
-                    static_cast<long>(mp[i][j][0].GetDouble()),
-                    static_cast<long>(mp[i][j][1].GetDouble())
-                });
-            }
-        }
+void BuildMultiPolygon(const Value& coords, bool texasCoord, MultiPolygon& multiPolygon) {
+    /*
+        @desc: fills the border of `multiPolygon` from geojson multipolygon coordinates
+        @params:
+            `const Value&` coords: array of polygon coordinate arrays
+            `bool` texasCoord: whether coordinates are already scaled
+            `MultiPolygon&` multiPolygon: multipolygon to fill
 
-        // make sure that all holes are closed
-        if (mp[i][0][0] != mp[i][mp[i].Size() - 1][0] || 
-            mp[i][0][1] != mp[i][mp[i].Size() - 1][1]) {       
-            hole.border.push_back(hole.border[0]);
-        }
+        @return: void
+    */
 
-        v.holes.push_back(hole);
+    multiPolygon.border.resize(coords.Size());
+    for (SizeType i = 0; i < coords.Size(); i++) {
+        BuildPolygon(coords[i], texasCoord, multiPolygon.border[i]);
     }
+}
+
 
+Polygon hte::StringToPoly(string str, bool texasCoord) {
+    /*
+        @desc: takes a json array string and returns a parsed shape object
+        @params: `string` str: data to be parsed
+        @return: `Polygon` parsed shape
+    */
+
+    Document mp;
+    mp.Parse(str.c_str());
+
+    Polygon v;
+    BuildPolygon(mp, texasCoord, v);
     return v;
 }
 
@@ -225,386 +316,645 @@ MultiPolygon hte::StringToMultiPoly(string str, bool texasCoord) {
         @return: `Polygon` parsed multishape
     */
 
-    MultiPolygon v;
-
     Document mp;
     mp.Parse(str.c_str());
 
-    for (int i = 0; i < mp.Size(); i++) {
-        // for each polygon
-        StringBuffer buffer;
-        buffer.Clear();
-        Writer<rapidjson::StringBuffer> writer(buffer);
-        mp[i].Accept(writer);
-
-        Polygon polygon = hte::StringToPoly(buffer.GetString(), texasCoord);
-        v.border.push_back(polygon);
-    }
-
+    MultiPolygon v;
+    BuildMultiPolygon(mp, texasCoord, v);
     return v;
 }
 
 
-vector<Precinct> ParsePrecinctData(string geoJSON) {
+void AddPrecinctsFromFeature(const Value& feature, vector<Precinct>& shapesVector) {
     /* 
         @desc:
-            Parses a geoJSON file into an array of Polygon
-            objects - finds ID using top-level defined constants,
-            and splits multipolygons into separate shapes (of the same id)
+            Parses a single geoJSON feature into Precinct objects -
+            finds ID using top-level defined constants, and splits
+            multipolygons into separate shapes (of the same id)
     
-        @params: `string` geoJSON: geojson precincts to be parsed
-        @return: `vector<Polygon>` precinct objects with all data
-    */
+        @params:
+            `const Value&` feature: geojson feature to be parsed
+            `vector<Precinct>&` shapesVector: list to add parsed precincts to
 
-    Document shapes;
-    shapes.Parse(geoJSON.c_str()); // parse json
+        @return: void
+    */
 
-    // vector of shapes to be returned
-    vector<Precinct> shapesVector;
+    const Value& properties = feature["properties"];
+    const Value& coords = feature["geometry"]["coordinates"];
+    string id = "";
+    int pop = 0;
 
-    for (int i = 0; i < shapes["features"].Size(); i++) {
-        string coords;
-        string id = "";
-        int pop = 0;
-
-        // see if the geoJSON contains the shape id
-        if (shapes["features"][i]["properties"].HasMember(idHeaders[IdType::GEOID].c_str())) {
-            if (shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].IsInt()) {
-                id = std::to_string(shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].GetInt());
-            }
-            else if (shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].IsString()) {
-                id = shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].GetString();
-            }
+    // see if the geoJSON contains the shape id
+    if (properties.HasMember(idHeaders[IdType::GEOID].c_str())) {
+        if (properties[idHeaders[IdType::GEOID].c_str()].IsInt()) {
+            id = std::to_string(properties[idHeaders[IdType::GEOID].c_str()].GetInt());
         }
-        else {
-            std::cout << "\e[31merror: \e[0mYou have no precinct id." << endl;
-            std::cout << "If future k-vernooy runs into this error, it means that GEOID10 in your geoJSON in your voter data is missing. To fix... maybe try a loose comparison of the names?" << endl;
+        else if (properties[idHeaders[IdType::GEOID].c_str()].IsString()) {
+            id = properties[idHeaders[IdType::GEOID].c_str()].GetString();
         }
+    }
+    else {
+        std::cout << "\e[31merror: \e[0mYou have no precinct id." << endl;
+        std::cout << "If future k-vernooy runs into this error, it means that GEOID10 in your geoJSON in your voter data is missing. To fix... maybe try a loose comparison of the names?" << endl;
+    }
 
-        // get voter data from geodata
-        map<PoliticalParty, int> voterData;
+    // get voter data from geodata
+    map<PoliticalParty, int> voterData;
 
-        // get all democrat data from JSON, and add it to the total
-        for (auto& partyHeader : electionHeaders) {
-            int vote = -1;
-            if (shapes["features"][i]["properties"].HasMember(partyHeader.second.c_str())) {
-                if (shapes["features"][i]["properties"][partyHeader.second.c_str()].IsInt()) {
-                    vote = shapes["features"][i]["properties"][partyHeader.second.c_str()].GetInt();
-                }
-                else if (shapes["features"][i]["properties"][partyHeader.second.c_str()].IsDouble()) {
-                    vote = (int) shapes["features"][i]["properties"][partyHeader.second.c_str()].GetDouble();
-                }
-                else if (shapes["features"][i]["properties"][partyHeader.second.c_str()].IsString()) {
-                    string str = shapes["features"][i]["properties"][partyHeader.second.c_str()].GetString();
-                    if (str != "NA" && str != "" && str != " ")
-                        vote = stoi(shapes["features"][i]["properties"][partyHeader.second.c_str()].GetString());
-                }
-                else std::cout << "VOTER DATA IN UNRECOGNIZED OR UNPARSABLE TYPE." << endl;
+    // get all democrat data from JSON, and add it to the total
+    for (auto& partyHeader : electionHeaders) {
+        int vote = -1;
+        if (properties.HasMember(partyHeader.second.c_str())) {
+            if (properties[partyHeader.second.c_str()].IsInt()) {
+                vote = properties[partyHeader.second.c_str()].GetInt();
+            }
+            else if (properties[partyHeader.second.c_str()].IsDouble()) {
+                vote = (int) properties[partyHeader.second.c_str()].GetDouble();
             }
-            else std::cout << "\e[31merror: \e[0mNo voter data near parse.cpp:314 " << partyHeader.second << endl;
-            voterData[partyHeader.first] = vote;
+            else if (properties[partyHeader.second.c_str()].IsString()) {
+                string str = properties[partyHeader.second.c_str()].GetString();
+                if (str != "NA" && str != "" && str != " ")
+                    vote = stoi(properties[partyHeader.second.c_str()].GetString());
+            }
+            else std::cout << "VOTER DATA IN UNRECOGNIZED OR UNPARSABLE TYPE." << endl;
         }
-        
+        else std::cout << "\e[31merror: \e[0mNo voter data near parse.cpp:314 " << partyHeader.second << endl;
+        voterData[partyHeader.first] = vote;
+    }
+    
 
-        // get the population data from geodata
-        if (shapes["features"][i]["properties"].HasMember(idHeaders[IdType::POPUID].c_str())) {
-            if (shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].IsInt()) {
-                pop = shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].GetInt();
-            }
-            else if (shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].IsString()) {
-                string test = shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].GetString();
-                if (test != "" && test != "NA") {
-                    pop = stoi(test);
-                }
+    // get the population data from geodata
+    if (properties.HasMember(idHeaders[IdType::POPUID].c_str())) {
+        if (properties[idHeaders[IdType::POPUID].c_str()].IsInt()) {
+            pop = properties[idHeaders[IdType::POPUID].c_str()].GetInt();
+        }
+        else if (properties[idHeaders[IdType::POPUID].c_str()].IsString()) {
+            string test = properties[idHeaders[IdType::POPUID].c_str()].GetString();
+            if (test != "" && test != "NA") {
+                pop = stoi(test);
             }
         }
-        else std::cout << "\e[31merror: \e[0mNo population data" << endl;
+    }
+    else std::cout << "\e[31merror: \e[0mNo population data" << endl;
 
-        bool texasCoordinates = false;
-        #ifdef TEXAS_COORDS
-        texasCoordinates = true;
-        #endif
+    bool texasCoordinates = false;
+    #ifdef TEXAS_COORDS
+    texasCoordinates = true;
+    #endif
 
-        // create empty string buffer
-        StringBuffer buffer;
-        buffer.Clear();
-        Writer<rapidjson::StringBuffer> writer(buffer);
+    if (feature["geometry"]["type"] == "Polygon") {
+        // build the polygon straight from the coordinate array
+        Polygon geo;
+        BuildPolygon(coords, texasCoordinates, geo);
+        Precinct precinct(std::move(geo.hull), pop, id);
+        precinct.shapeId = id;
+
+        if (electionHeaders.find(PoliticalParty::Other) == electionHeaders.end()) {
+            if (electionHeaders.find(PoliticalParty::Total) != electionHeaders.end()) {
+                int other = voterData[PoliticalParty::Total];
+                for (auto& party : electionHeaders) {
+                    if (party.first != PoliticalParty::Total) {
+                        other -= voterData[party.first];
+                    }
+                }
+                voterData[PoliticalParty::Other] = other;
+            }
+        }
 
-        // write the coordinate array to a string
-        shapes["features"][i]["geometry"]["coordinates"].Accept(writer);
-        coords = buffer.GetString();
+        precinct.voterData = voterData;
 
-        if (shapes["features"][i]["geometry"]["type"] == "Polygon") {
-            // vector parsed from coordinate string
-            Polygon geo = StringToPoly(coords, texasCoordinates);
-            Precinct precinct(geo.hull, pop, id);
-            precinct.shapeId = id;
+        precinct.holes = std::move(geo.holes);
+        shapesVector.push_back(std::move(precinct));
+    }
+    else {
+        MultiPolygon geo;
+        BuildMultiPolygon(coords, texasCoordinates, geo);
+        geo.shapeId = id;
+
+        // calculate area of multipolygon
+        double totalArea = abs(geo.getSignedArea());
+        int append = 0;
+
+        for (Polygon s : geo.border) {
+            double fract = abs(s.getSignedArea()) / totalArea;
+            pop = round(static_cast<double>(pop) * static_cast<double>(fract));
+
+            map<PoliticalParty, int> adjusted;
+            for (auto& partyData : voterData) {
+                adjusted[partyData.first] = static_cast<int>(static_cast<double>(partyData.second) * fract);
+            }
 
             if (electionHeaders.find(PoliticalParty::Other) == electionHeaders.end()) {
                 if (electionHeaders.find(PoliticalParty::Total) != electionHeaders.end()) {
-                    int other = voterData[PoliticalParty::Total];
+                    int other = adjusted[PoliticalParty::Total];
+
                     for (auto& party : electionHeaders) {
                         if (party.first != PoliticalParty::Total) {
-                            other -= voterData[party.first];
+                            other -= adjusted[party.first];
                         }
                     }
-                    voterData[PoliticalParty::Other] = other;
+
+                    adjusted[PoliticalParty::Other] = other;
                 }
             }
 
-            precinct.voterData = voterData;
-
-            for (int i = 0; i < geo.holes.size(); i++)
-                precinct.holes.push_back(geo.holes[i]);
-
+            Precinct precinct(s.hull, pop, (id + "_s" + std::to_string(append)));
+            precinct.holes = s.holes;
+            precinct.voterData = adjusted;
             shapesVector.push_back(precinct);
+            append++;
         }
-        else {
-            MultiPolygon geo = StringToMultiPoly(coords, texasCoordinates);
-            geo.shapeId = id;
-
-            // calculate area of multipolygon
-            double totalArea = abs(geo.getSignedArea());
-            int append = 0;
-
-            for (Polygon s : geo.border) {
-                double fract = abs(s.getSignedArea()) / totalArea;
-                pop = round(static_cast<double>(pop) * static_cast<double>(fract));
+    }
+}
 
-                map<PoliticalParty, int> adjusted;
-                for (auto& partyData : voterData) {
-                    adjusted[partyData.first] = static_cast<int>(static_cast<double>(partyData.second) * fract);
-                }
 
-                if (electionHeaders.find(PoliticalParty::Other) == electionHeaders.end()) {
-                    if (electionHeaders.find(PoliticalParty::Total) != electionHeaders.end()) {
-                        int other = adjusted[PoliticalParty::Total];
+void AddShapesFromFeature(const Value& feature, vector<Polygon>& shapesVector) {
+    /* 
+        @desc:
+            Parses a single geoJSON feature into Polygon objects -
+            finds ID using top-level defined constants, and splits
+            multipolygons into separate shapes (of the same id)
+    
+        @params:
+            `const Value&` feature: geojson feature to be parsed
+            `vector<Polygon>&` shapesVector: list to add parsed shapes to
 
-                        for (auto& party : electionHeaders) {
-                            if (party.first != PoliticalParty::Total) {
-                                other -= adjusted[party.first];
-                            }
-                        }
+        @return: void
+    */
 
-                        adjusted[PoliticalParty::Other] = other;
-                    }
-                }
+    const Value& properties = feature["properties"];
+    const Value& coords = feature["geometry"]["coordinates"];
+    string id = "";
+    int pop = 0;
+ 
+    // see if the geoJSON contains the shape id
+    if (properties.HasMember(idHeaders[IdType::GEOID].c_str())) {
+        if (properties[idHeaders[IdType::GEOID].c_str()].IsInt()) {
+            id = std::to_string(properties[idHeaders[IdType::GEOID].c_str()].GetInt());
+        }
+        else if (properties[idHeaders[IdType::GEOID].c_str()].IsString()) {
+            id = properties[idHeaders[IdType::GEOID].c_str()].GetString();
+        }
+    }
+    else {
+        std::cout << idHeaders[IdType::GEOID] << endl;
+        std::cout << "\e[31merror: \e[0mYou have no precinct id." << endl;
+    }
 
-                Precinct precinct(s.hull, pop, (id + "_s" + std::to_string(append)));
-                precinct.holes = s.holes;
-                precinct.voterData = adjusted;
-                shapesVector.push_back(precinct);
-                append++;
-            }
+    // get the population from geodata
+    if (properties.HasMember(idHeaders[IdType::POPUID].c_str())) {
+        if (properties[idHeaders[IdType::POPUID].c_str()].IsInt())
+            pop = properties[idHeaders[IdType::POPUID].c_str()].GetInt();
+        else if (properties[idHeaders[IdType::POPUID].c_str()].IsString()){
+            string tmp = properties[idHeaders[IdType::POPUID].c_str()].GetString();
+            if (tmp != "" && tmp != "NA") pop = stoi(tmp);
+        }
+        else {
+            std::cout << "Population data in unparseable format." << endl;
         }
     }
+    else {
+        cerr << idHeaders[IdType::POPUID] << endl;
+        cerr << "\e[31merror: \e[0mNo population data" << endl;
+    }
 
-    return shapesVector;
+    bool texasCoordinates = false;
+    #ifdef TEXAS_COORDS
+        texasCoordinates = true;
+    #endif
+    
+    if (feature["geometry"]["type"] == "Polygon") {
+        // build the polygon straight from the coordinate array
+        Polygon shape;
+        BuildPolygon(coords, texasCoordinates, shape);
+        shape.pop = pop;
+        shape.shapeId = id;
+        shapesVector.push_back(std::move(shape));
+    }
+    else {
+        MultiPolygon geo;
+        BuildMultiPolygon(coords, texasCoordinates, geo);
+        geo.shapeId = id;
+        double totalArea = abs(geo.getSignedArea());
+
+        // create many shapes with the same ID, add them to the array            
+        int append = 0;
+        for (Polygon s : geo.border) {
+            Polygon shape(s.hull, s.holes, id);
+            shape.isPartOfMultiPolygon = append;
+            double fract = abs(shape.getSignedArea()) / totalArea;
+            shape.pop = static_cast<int>(round(pop * fract));
+            shapesVector.push_back(shape);
+            append++;
+        }
+    }
 }
 
 
-vector<Polygon> ParsePrecinctCoordinates(string geoJSON) {
+void AddDistrictFromFeature(const Value& feature, vector<MultiPolygon>& shapesVector) {
     /* 
-        @desc:
-            Parses a geoJSON file into an array of Polygon
-            objects - finds ID using top-level defined constants,
-            and splits multipolygons into separate shapes (of the same id)
-    
-        @params: `string` geoJSON: geojson precincts to be parsed
-        @return: `vector<Polygon>` precinct objects with coordinate data
+        @desc: Parses a single geoJSON feature into a MultiPolygon district
+        @params:
+            `const Value&` feature: geojson feature to be parsed
+            `vector<MultiPolygon>&` shapesVector: list to add the district to
+
+        @return: void
     */
 
-    Document shapes;
-    shapes.Parse(geoJSON.c_str()); // parse json
+    const Value& coords = feature["geometry"]["coordinates"];
+    shapesVector.emplace_back();
 
-    // vector of shapes to be returned
-    vector<Polygon> shapesVector;
+    if (feature["geometry"]["type"] == "Polygon") {
+        // a single polygon district
+        shapesVector.back().border.resize(1);
+        BuildPolygon(coords, false, shapesVector.back().border[0]);
+    }
+    else {
+        BuildMultiPolygon(coords, false, shapesVector.back());
+    }
+}
 
-    for ( int i = 0; i < shapes["features"].Size(); i++ ) {
-        string coords;
-        string id = "";
-        int pop = 0;
- 
-        // see if the geoJSON contains the shape id
-        if (shapes["features"][i]["properties"].HasMember(idHeaders[IdType::GEOID].c_str())) {
-            if (shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].IsInt()) {
-                id = std::to_string(shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].GetInt());
-            }
-            else if (shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].IsString()) {
-                id = shapes["features"][i]["properties"][idHeaders[IdType::GEOID].c_str()].GetString();
+
+/**
+ * \brief SAX handler that builds geojson features one at a time
+ * 
+ * Follows rapidjson's Reader through a FeatureCollection and builds
+ * a DOM value for only the feature currently being read. When the
+ * feature's object closes, it is passed to `onFeature` and its memory
+ * is released, so peak memory stays at one feature regardless of the
+ * size of the file.
+ */
+class FeatureHandler : public BaseReaderHandler<UTF8<>, FeatureHandler> {
+    public:
+        FeatureHandler(std::function<void(Value&)> onFeature)
+            : onFeature(onFeature), allocator(FEATURE_CHUNK_SIZE) {}
+
+        bool Null() { return addValue(Value()); }
+        bool Bool(bool b) { return addValue(Value(b)); }
+        bool Int(int i) { return addValue(Value(i)); }
+        bool Uint(unsigned u) { return addValue(Value(u)); }
+        bool Int64(int64_t i) { return addValue(Value(i)); }
+        bool Uint64(uint64_t u) { return addValue(Value(u)); }
+        bool Double(double d) { return addValue(Value(d)); }
+
+        bool String(const char* str, SizeType length, bool) {
+            if (values.empty()) return true;
+            return addValue(Value(str, length, allocator));
+        }
+
+        bool Key(const char* str, SizeType length, bool) {
+            if (values.empty()) {
+                // keys outside of a feature, only care about the collection
+                if (depth == 1) inFeatureKey = (string(str, length) == "features");
+                return true;
             }
+
+            keys.push_back(Value(str, length, allocator));
+            return true;
         }
-        else {
-            std::cout << idHeaders[IdType::GEOID] << endl;
-            std::cout << "\e[31merror: \e[0mYou have no precinct id." << endl;
+
+        bool StartObject() {
+            depth++;
+            if (values.empty() && !(inFeatureKey && depth == 3)) return true;
+            values.push_back(Value(kObjectType));
+            return true;
         }
 
-        // get the population from geodata
-        if (shapes["features"][i]["properties"].HasMember(idHeaders[IdType::POPUID].c_str())) {
-            if (shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].IsInt())
-                pop = shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].GetInt();
-            else if (shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].IsString()){
-                string tmp = shapes["features"][i]["properties"][idHeaders[IdType::POPUID].c_str()].GetString();
-                if (tmp != "" && tmp != "NA") pop = stoi(tmp);
-            }
-            else {
-                std::cout << "Population data in unparseable format." << endl;
-            }
+        bool EndObject(SizeType) {
+            depth--;
+            if (values.empty()) return true;
+            return closeValue();
         }
-        else {
-            cerr << idHeaders[IdType::POPUID] << endl;
-            cerr << "\e[31merror: \e[0mNo population data" << endl;
+
+        bool StartArray() {
+            depth++;
+            if (values.empty()) return true;
+            values.push_back(Value(kArrayType));
+            return true;
         }
 
-        bool texasCoordinates = false;
-        #ifdef TEXAS_COORDS
-            texasCoordinates = true;
-        #endif
-        
-        // create empty string buffer
-        StringBuffer buffer;
-        buffer.Clear();
-        Writer<rapidjson::StringBuffer> writer(buffer);
-
-        // write the coordinate array to a string
-        shapes["features"][i]["geometry"]["coordinates"].Accept(writer);
-        coords = buffer.GetString();
-
-
-        if (shapes["features"][i]["geometry"]["type"] == "Polygon") {
-            // vector parsed from coordinate string
-            Polygon geo = StringToPoly(coords, texasCoordinates);
-            LinearRing border = geo.hull;
-            Polygon shape(border, id);
-            shape.pop = pop;
-            shape.shapeId = id;
-
-            for (int i = 0; i < geo.holes.size(); i++)
-                shape.holes.push_back(geo.holes[i]);
-            shapesVector.push_back(shape);
+        bool EndArray(SizeType) {
+            depth--;
+            if (values.empty()) {
+                if (depth == 1) inFeatureKey = false;
+                return true;
+            }
+
+            return closeValue();
         }
-        else {
-            MultiPolygon geo = StringToMultiPoly(coords, texasCoordinates);
-            geo.shapeId = id;
-            double totalArea = abs(geo.getSignedArea());
-
-            // create many shapes with the same ID, add them to the array            
-            int append = 0;
-            for (Polygon s : geo.border) {
-                Polygon shape(s.hull, s.holes, id);
-                shape.isPartOfMultiPolygon = append;
-                double fract = abs(shape.getSignedArea()) / totalArea;
-                shape.pop = static_cast<int>(round(pop * fract));
-                shapesVector.push_back(shape);
-                append++;
+
+    private:
+        // the size of each allocation for a feature's values
+        static const size_t FEATURE_CHUNK_SIZE = 1 << 16;
+
+        std::function<void(Value&)> onFeature;
+        MemoryPoolAllocator<> allocator;
+
+        vector<Value> values;  // open objects and arrays of the current feature
+        vector<Value> keys;    // member names waiting for their value
+        int depth = 0;
+        bool inFeatureKey = false;
+
+        bool addValue(Value&& v) {
+            // values outside of a feature are skipped
+            if (values.empty()) return true;
+
+            if (values.back().IsArray()) {
+                values.back().PushBack(v, allocator);
+            }
+            else {
+                values.back().AddMember(keys.back(), v, allocator);
+                keys.pop_back();
             }
+
+            return true;
         }
-    }
 
-    return shapesVector;
-}
+        bool closeValue() {
+            if (values.size() == 1) {
+                // the feature is complete
+                onFeature(values.back());
+                values.clear();
+                keys.clear();
+                allocator.Clear();
+                return true;
+            }
 
+            Value v(std::move(values.back()));
+            values.pop_back();
+            return addValue(std::move(v));
+        }
+};
 
-vector<MultiPolygon> ParseDistrictCoordinates(string geoJSON) {
-    /* 
-        @desc: Parses a geoJSON file into an array of MultiPolygon district objects
-        @params: `string` geoJSON: geojson precincts to be parsed
-        @return: `vector<MultiPolygon>` district objects with coordinate data
-    */
 
-    Document shapes;
-    shapes.Parse(geoJSON.c_str()); // parse json
+void StreamFeatures(string path, std::function<void(Value&)> onFeature) {
+    /*
+        @desc:
+            Reads a geojson FeatureCollection from disk through a
+            fixed size buffer, calling `onFeature` for each feature.
+            Throws `FileNotRead` if the file can't be opened, and
+            `GeoJsonInvalid` if it isn't valid json
+
+        @params:
+            `string` path: geojson file to read
+            `std::function<void(Value&)>` onFeature: called with each parsed feature
 
-    // vector of shapes to be returned
-    vector<MultiPolygon> shapesVector;
+        @return: void
+    */
 
-    for ( int i = 0; i < shapes["features"].Size(); i++ ) {
-        string coords;
-        int pop = 0;
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) throw Exceptions::FileNotRead();
 
-        // create empty string buffer
-        StringBuffer buffer;
-        buffer.Clear();
-        Writer<StringBuffer> writer(buffer);
+    vector<char> readBuffer(1 << 16);
+    FileReadStream stream(fp, readBuffer.data(), readBuffer.size());
+    FeatureHandler handler(onFeature);
 
-        // write the coordinate array to a string
-        shapes["features"][i]["geometry"]["coordinates"].Accept(writer);
-        coords = buffer.GetString();
+    Reader reader;
+    ParseResult result = reader.Parse(stream, handler);
+    fclose(fp);
 
-        if (shapes["features"][i]["geometry"]["type"] == "Polygon") {
-            // vector parsed from coordinate string
-            Polygon border = StringToPoly(coords, false);
-            MultiPolygon ms({border});
-            shapesVector.push_back(ms);
-        }
-        else {
-            MultiPolygon borders = StringToMultiPoly(coords, false);
-            shapesVector.push_back(borders);
-        }
+    if (!result) {
+        cerr << "\e[31merror: \e[0m" << GetParseError_En(result.Code())
+             << " in " << path << " at offset " << result.Offset() << endl;
+        throw Exceptions::GeoJsonInvalid();
     }
-
-    return shapesVector;
 }
 
 
-vector<Precinct> MergeData(vector<Polygon> precinctShapes, map<string, map<PoliticalParty, int> > voterData) {
+void hte::ParseKeys(string keys, map<IdType, string>& ids, map<PoliticalParty, string>& parties) {
     /*
         @desc:
-            returns an array of precinct objects given
-            geodata (shape objects) and voter data
-            in the form of a map for a list of precincts
+            reads a set of header keys in the format
+            `{"KEY":"VALUE","KEY2":"VAL2"}` (see build_data.list)
+            into id and voter data column headers
 
         @params:
-            `vector<Polygon>` precinct_shapes: coordinate data with id's
-            `map<string, vector<int>>` voter_data: voting data with id's
+            `string` keys: the key set to read
+            `map<IdType, string>&` ids: filled with id columns
+            `map<PoliticalParty, string>&` parties: filled with voter data columns
+
+        @return: void
     */
 
-    vector<Precinct> precincts;
+    bool done = false;
+    while (!done) {
+        string rem = keys.substr(keys.find('"'), keys.size());
+        string key = rem.substr(0, rem.find(":"));
+        key = string(key.begin() + 1, key.end() - 1);
 
-    int x = 0;
+        string search = ",";
+        if (rem.find(search) == string::npos) {
+            search = "}";
+            done = true;
+        }
 
-    for (Polygon precinctShape : precinctShapes) {
-        // iterate over shapes array, get the id of the current shape
-        string pId = precinctShape.shapeId;
-        map<PoliticalParty, int> pData = {}; // the voter data to be filled
+        string val = rem.substr(rem.find(":") + 1, rem.find(search) - rem.find(":") - 1);
+        val = string(val.begin() + 1, val.end() - 1);
+
+        if (key == "GEO") ids[IdType::GEOID] = val;
+        else if (key == "ELE") ids[IdType::ELECTIONID] = val;
+        else if (key == "POP") ids[IdType::POPUID] = val;
+        else if (key == "BLK") ids[IdType::BLOCKID] = val;
+        else if (key == "BPOP") ids[IdType::BLOCKPOPUID] = val;
+        else if (key == "DEM") parties[PoliticalParty::Democrat] = val;
+        else if (key == "REP") parties[PoliticalParty::Republican] = val;
+        else if (key == "LIB") parties[PoliticalParty::Libertarian] = val;
+        else if (key == "REF") parties[PoliticalParty::Reform] = val;
+        else if (key == "GRE") parties[PoliticalParty::Green] = val;
+        else if (key == "IND") parties[PoliticalParty::Independent] = val;
+        else if (key == "OTH") parties[PoliticalParty::Other] = val;
+        else if (key == "TOT") parties[PoliticalParty::Total] = val;
+        else cout << "unrecognized key " << key << endl;
+
+        if (!done) keys = rem.substr(rem.find(","), rem.size() - rem.find(","));
+    }
+}
 
-        if (voterData.find(pId) == voterData.end() ) {
-            // there is no matching id in the voter data
-            std::cout << "error: the id \e[41m" << pId << "\e[0m, has no matching key in voter_data, will not be filled" << endl;
-        }
-        else {
-            // get the voter data of the precinct
-            pData = voterData[pId];
-        }
 
-        // create a precinct object and add it to the array
-        if (precinctShape.isPartOfMultiPolygon != -1) {
-            double totalArea = abs(precinctShape.getSignedArea());
+Document ParseJson(const string& json) {
+    // parse a json string into a new document
+    Document document;
+    document.Parse(json.c_str());
+    return document;
+}
 
-            for (int i = 0; i < precinctShapes.size(); i++) {
-                if (i != x && precinctShapes[i].shapeId == pId) {
-                    totalArea += abs(precinctShapes[i].getSignedArea());
-                }
-            }
 
-            double ratio = abs(precinctShape.getSignedArea()) / totalArea;
+Document ParseJson(MappedFile& file) {
+    // parse a mapped file in place, strings in the
+    // document point into the file's mapping
+    Document document;
+    document.ParseInsitu(file.data());
+    return document;
+}
 
-            Precinct precinct = Precinct(
-                precinctShape.hull, 
-                precinctShape.holes, 
-                pId + "_s" + std::to_string(precinctShape.isPartOfMultiPolygon)
-            );
-            
-            for (auto const& x : pData) {
-                precinct.voterData[x.first] = static_cast<int>(static_cast<double>(x.second) * static_cast<double>(ratio));
-            }
 
-            if (electionHeaders.find(PoliticalParty::Other) == electionHeaders.end()) {
-                if (electionHeaders.find(PoliticalParty::Total) != electionHeaders.end()) {
-                    int other = precinct.voterData[PoliticalParty::Total];
-                    for (auto& party : electionHeaders) {
-                        if (party.first != PoliticalParty::Total) {
-                            other -= precinct.voterData[party.first];
+vector<Precinct> ParsePrecinctData(const Document& shapes) {
+    /* 
+        @desc:
+            Parses a geoJSON file into an array of Polygon
+            objects - finds ID using top-level defined constants,
+            and splits multipolygons into separate shapes (of the same id)
+    
+        @params: `const Document&` shapes: parsed geojson precincts
+        @return: `vector<Polygon>` precinct objects with all data
+    */
+
+    // vector of shapes to be returned
+    vector<Precinct> shapesVector;
+
+    for (int i = 0; i < shapes["features"].Size(); i++) {
+        AddPrecinctsFromFeature(shapes["features"][i], shapesVector);
+    }
+
+    return shapesVector;
+}
+
+
+vector<Precinct> StreamPrecinctData(string path) {
+    // streaming equivalent of `ParsePrecinctData`, reads from a file path
+    vector<Precinct> shapesVector;
+    StreamFeatures(path, [&shapesVector](Value& feature) {
+        AddPrecinctsFromFeature(feature, shapesVector);
+    });
+
+    return shapesVector;
+}
+
+
+vector<Polygon> ParsePrecinctCoordinates(const Document& shapes) {
+    /* 
+        @desc:
+            Parses a geoJSON file into an array of Polygon
+            objects - finds ID using top-level defined constants,
+            and splits multipolygons into separate shapes (of the same id)
+    
+        @params: `const Document&` shapes: parsed geojson precincts
+        @return: `vector<Polygon>` precinct objects with coordinate data
+    */
+
+    // vector of shapes to be returned
+    vector<Polygon> shapesVector;
+
+    for ( int i = 0; i < shapes["features"].Size(); i++ ) {
+        AddShapesFromFeature(shapes["features"][i], shapesVector);
+    }
+
+    return shapesVector;
+}
+
+
+vector<Polygon> StreamPrecinctCoordinates(string path) {
+    // streaming equivalent of `ParsePrecinctCoordinates`, reads from a file path
+    vector<Polygon> shapesVector;
+    StreamFeatures(path, [&shapesVector](Value& feature) {
+        AddShapesFromFeature(feature, shapesVector);
+    });
+
+    return shapesVector;
+}
+
+
+vector<MultiPolygon> ParseDistrictCoordinates(const Document& shapes) {
+    /* 
+        @desc: Parses a geoJSON file into an array of MultiPolygon district objects
+        @params: `const Document&` shapes: parsed geojson districts
+        @return: `vector<MultiPolygon>` district objects with coordinate data
+    */
+
+    // vector of shapes to be returned
+    vector<MultiPolygon> shapesVector;
+
+    for ( int i = 0; i < shapes["features"].Size(); i++ ) {
+        AddDistrictFromFeature(shapes["features"][i], shapesVector);
+    }
+
+    return shapesVector;
+}
+
+
+vector<MultiPolygon> StreamDistrictCoordinates(string path) {
+    // streaming equivalent of `ParseDistrictCoordinates`, reads from a file path
+    vector<MultiPolygon> shapesVector;
+    StreamFeatures(path, [&shapesVector](Value& feature) {
+        AddDistrictFromFeature(feature, shapesVector);
+    });
+
+    return shapesVector;
+}
+
+
+vector<Precinct> hte::MergeData(vector<Polygon>& precinctShapes, const VoterTable& voterData) {
+    /*
+        @desc:
+            returns an array of precinct objects given
+            geodata (shape objects) and voter data
+            in the form of a map for a list of precincts.
+            Pieces of multipolygons are grouped by id
+            first, so each piece's share of its precinct's
+            votes is found without rescanning every shape
+
+        @params:
+            `vector<Polygon>` precinct_shapes: coordinate data with id's
+            `VoterTable` voter_data: voting data with id's
+    */
+
+    vector<Precinct> precincts;
+    precincts.reserve(precinctShapes.size());
+
+    // total area of every shape sharing an id with a multipolygon
+    // piece, and the cached area of each of those shapes
+    unordered_map<string, double> groupAreas;
+    vector<double> areas(precinctShapes.size(), 0);
+
+    for (const Polygon& precinctShape : precinctShapes) {
+        if (precinctShape.isPartOfMultiPolygon != -1)
+            groupAreas[precinctShape.shapeId] = 0;
+    }
+
+    for (int i = 0; i < precinctShapes.size(); i++) {
+        auto group = groupAreas.find(precinctShapes[i].shapeId);
+        if (group != groupAreas.end()) {
+            areas[i] = abs(precinctShapes[i].getSignedArea());
+            group->second += areas[i];
+        }
+    }
+
+    for (int x = 0; x < precinctShapes.size(); x++) {
+        // iterate over shapes array, get the id of the current shape
+        Polygon& precinctShape = precinctShapes[x];
+        const string& pId = precinctShape.shapeId;
+        map<PoliticalParty, int> pData = {}; // the voter data to be filled
+
+        auto pVoterData = voterData.rows.find(pId);
+        if (pVoterData == voterData.rows.end()) {
+            // there is no matching id in the voter data
+            std::cout << "error: the id \e[41m" << pId << "\e[0m, has no matching key in voter_data, will not be filled" << endl;
+        }
+        else {
+            // get the voter data of the precinct
+            pData = voterData.getVotes(pVoterData->second);
+        }
+
+        // create a precinct object and add it to the array
+        if (precinctShape.isPartOfMultiPolygon != -1) {
+            double ratio = areas[x] / groupAreas[pId];
+
+            Precinct precinct = Precinct(
+                precinctShape.hull, 
+                precinctShape.holes, 
+                pId + "_s" + std::to_string(precinctShape.isPartOfMultiPolygon)
+            );
+            
+            for (auto const& x : pData) {
+                precinct.voterData[x.first] = static_cast<int>(static_cast<double>(x.second) * static_cast<double>(ratio));
+            }
+
+            if (electionHeaders.find(PoliticalParty::Other) == electionHeaders.end()) {
+                if (electionHeaders.find(PoliticalParty::Total) != electionHeaders.end()) {
+                    int other = precinct.voterData[PoliticalParty::Total];
+                    for (auto& party : electionHeaders) {
+                        if (party.first != PoliticalParty::Total) {
+                            other -= precinct.voterData[party.first];
                         }
                     }
                     precinct.voterData[PoliticalParty::Other] = other;
@@ -636,7 +986,6 @@ vector<Precinct> MergeData(vector<Polygon> precinctShapes, map<string, map<Polit
             precinct.pop = precinctShape.pop;
             precincts.push_back(precinct);
         }
-        x++;
     }
 
     return precincts; // return precincts array
@@ -647,57 +996,70 @@ PrecinctGroup CombineHoles(PrecinctGroup pg) {
     /*
         Takes a precinct group, iterates through precincts
         with holes, and combines internal precinct data to
-        eliminate holes from the precinct group
+        eliminate holes from the precinct group. Only
+        precincts whose bounding boxes meet one of a hole's
+        bounding box are checked for being inside it
     */
 
     vector<Precinct> precincts;
-    vector<int> precinctsToIgnore;
+    vector<bool> precinctsToIgnore(pg.precincts.size(), false);
 
-    vector<BoundingBox> bounds;
-    for (Precinct p : pg.precincts) {
-        bounds.push_back(p.getBoundingBox());
+    // index every precinct's bounding box
+    vector<pair<BoostBox, int> > bounds;
+    bounds.reserve(pg.precincts.size());
+    for (int i = 0; i < pg.precincts.size(); i++) {
+        bounds.push_back({BoundingBoxToBoostBox(pg.precincts[i].getBoundingBox()), i});
     }
 
+    BoundingBoxIndex boundIndex(bounds.begin(), bounds.end());
+    vector<int> candidates;
 
     for (int x = 0; x < pg.precincts.size(); x++) {
         // for each precinct in the pg array
-        Precinct p = pg.precincts[x];
+        const Precinct& p = pg.precincts[x];
 
         // define starting precinct metadata
-        LinearRing precinctBorder = p.hull;
-        string id = p.shapeId;
         map<PoliticalParty, int> voter = p.voterData;
         int pop = p.pop;
 
         if (p.holes.size() > 0) {
-            // need to remove precinct holes
-            int interior_pre = 0; // precincts inside the hole
-            for (int j = 0; j < pg.precincts.size(); j++) {
-                // check all other precincts for if they're inside
-                Precinct pC = pg.precincts[j];
-
-                if (GetBoundOverlap(bounds[x], bounds[j])) {
-                    if (j != x && GetInside(pC.hull, p.hull)) {
-                        // precinct j is inside precinct x,
-                        // add the appropriate data from j to x
-                        for (auto const& x : pg.precincts[j].voterData) {
-                            voter[x.first] += x.second;
-                        }
+            // need to remove precinct holes, so find
+            // all precincts that could be inside one
+            candidates.clear();
+            for (const LinearRing& hole : p.holes) {
+                vector<pair<BoostBox, int> > found;
+                boundIndex.query(
+                    boost::geometry::index::intersects(BoundingBoxToBoostBox(LinearRing(hole).getBoundingBox())),
+                    back_inserter(found)
+                );
+
+                for (auto& f : found) candidates.push_back(f.second);
+            }
 
-                        // demv += pg.precincts[j].dem;
-                        // repv += pg.precincts[j].rep;
-                        pop += pg.precincts[j].pop;
+            sort(candidates.begin(), candidates.end());
+            candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
 
-                        // this precinct will not be returned
-                        precinctsToIgnore.push_back(j);
-                        interior_pre++;
+            int interior_pre = 0; // precincts inside the hole
+            for (int j : candidates) {
+                // check the candidates for if they're inside
+                if (j != x && GetInside(pg.precincts[j].hull, p.hull)) {
+                    // precinct j is inside precinct x,
+                    // add the appropriate data from j to x
+                    for (auto const& x : pg.precincts[j].voterData) {
+                        voter[x.first] += x.second;
                     }
+
+                    pop += pg.precincts[j].pop;
+
+                    // this precinct will not be returned
+                    precinctsToIgnore[j] = true;
+                    interior_pre++;
                 }
             }
         }
 
         // create new precinct from updated data
-        Precinct np = Precinct(precinctBorder, pop, id);
+        Precinct np = Precinct(p.hull, pop, p.shapeId);
         np.voterData = voter;
         precincts.push_back(np);
     }
@@ -705,7 +1067,7 @@ PrecinctGroup CombineHoles(PrecinctGroup pg) {
     vector<Precinct> newPre; // the new precinct array to return
 
     for (int i = 0; i < precincts.size(); i++) {
-        if (!(std::find(precinctsToIgnore.begin(), precinctsToIgnore.end(), i) != precinctsToIgnore.end())) {
+        if (!precinctsToIgnore[i]) {
             // it is not a hole precinct, so add it
             newPre.push_back(precincts[i]);
         }
@@ -715,16 +1077,228 @@ PrecinctGroup CombineHoles(PrecinctGroup pg) {
 }
 
 
+void AddClippedEdges(Graph& graph, State& state, int threads) {
+    /*
+        @desc:
+            Adds edges between precincts whose shapes union into
+            one. Bordering checks are only made between precincts
+            with overlapping bounding boxes, and are split across
+            worker threads
+
+        @params:
+            `Graph&` graph: graph to add edges to
+            `State&` state: precincts of the graph's nodes, with attributes
+            `int` threads: number of workers, or 0 for one per core
+
+        @return: void
+    */
+
+    PrecinctGroup& pg = state;
+
+    // index bounding boxes for border-checks
+    vector<pair<BoostBox, int> > boundingBoxes;
+    boundingBoxes.reserve(pg.precincts.size());
+    for (int i = 0; i < pg.precincts.size(); i++) {
+        boundingBoxes.push_back({BoundingBoxToBoostBox(state.attributes[i].boundingBox), i});
+    }
+
+    BoundingBoxIndex boundIndex(boundingBoxes.begin(), boundingBoxes.end());
+
+    // the bordering precincts after each precinct, filled by workers
+    // that take precincts in turn from a shared counter
+    vector<vector<int> > bordering(pg.precincts.size());
+    atomic<int> next(0);
+
+    auto findBordering = [&]() {
+        vector<pair<BoostBox, int> > candidates;
+        for (int i = next++; i < pg.precincts.size(); i = next++) {
+            // check precincts with overlapping bounding boxes
+            candidates.clear();
+            boundIndex.query(boost::geometry::index::intersects(boundingBoxes[i].first), back_inserter(candidates));
+
+            for (auto& candidate : candidates) {
+                int j = candidate.second;
+                // check clip because bounding boxes overlap
+                if (j > i && GetBordering(pg.precincts[i], pg.precincts[j])) {
+                    bordering[i].push_back(j);
+                }
+            }
+        }
+    };
+
+    int nThreads = threads > 0 ? threads : max(1, static_cast<int>(thread::hardware_concurrency()));
+    vector<thread> workers;
+    for (int t = 1; t < nThreads; t++) workers.emplace_back(findBordering);
+    findBordering();
+    for (thread& worker : workers) worker.join();
+
+    // add bordering precincts as edges to the graph, in
+    // the same order regardless of how work was split
+    for (int i = 0; i < pg.precincts.size(); i++) {
+        sort(bordering[i].begin(), bordering[i].end());
+        for (int j : bordering[i]) {
+            graph.addEdge({j, i});
+        }
+    }
+}
+
+
+void AddSegmentEdges(Graph& graph, State& state) {
+    /*
+        @desc:
+            Adds edges between precincts that share arcs in the
+            state's topology, recording the total length of each
+            shared border. Borders only match when both precincts
+            have the same vertices, as in data where neighbours
+            share boundary points
+
+        @params:
+            `Graph&` graph: graph to add edges to
+            `State&` state: precincts of the graph's nodes, with topology
+
+        @return: void
+    */
+
+    map<Edge, double> borderLengths = state.topology.getBorderLengths();
+
+    // add edges in order of their node ids
+    for (auto& border : borderLengths) {
+        graph.addEdge({border.first[1], border.first[0]});
+        graph.borderLengths[border.first] = border.second;
+    }
+}
+
+
+int FindRoot(vector<int>& parents, int x) {
+    // finds the representative of a disjoint set, compressing the path
+    while (parents[x] != x) {
+        parents[x] = parents[parents[x]];
+        x = parents[x];
+    }
+
+    return x;
+}
+
+
+void LinkIslands(Graph& graph) {
+    /*
+        @desc:
+            Links the components of a graph by adding the edges
+            of a minimum spanning forest over components, where
+            components are joined by their closest pair of precinct
+            centroids. Each round, every component but the largest
+            finds its closest precinct in another component with
+            nearest neighbour queries, and the closest links are
+            joined, so the number of components at least halves
+
+        @params: `Graph&` graph: graph to link, with precinct nodes
+        @return: void
+    */
+
+    typedef pair<BoostPoint2d, int> IndexedPoint;
+    vector<int> keys;
+    vector<IndexedPoint> centers;
+
+    for (auto it = graph.vertices.begin(); it != graph.vertices.end(); ++it) {
+        // index the center of each precinct
+        Point2d center = it.value().precinct->getCentroid();
+        centers.push_back({BoostPoint2d(center.x, center.y), static_cast<int>(keys.size())});
+        keys.push_back(it.key());
+    }
+
+    boost::geometry::index::rtree<IndexedPoint, boost::geometry::index::rstar<16> > centerIndex(centers.begin(), centers.end());
+
+    // disjoint sets of the graph's current components
+    unordered_map<int, int> keyIndex;
+    for (int i = 0; i < keys.size(); i++) keyIndex[keys[i]] = i;
+
+    vector<int> parents(keys.size());
+    iota(parents.begin(), parents.end(), 0);
+    int nComponents = 0;
+
+    for (Graph& component : graph.getComponents()) {
+        int root = keyIndex[component.vertices.begin().key()];
+        for (auto it = component.vertices.begin(); it != component.vertices.end(); ++it) {
+            parents[keyIndex[it.key()]] = root;
+        }
+
+        nComponents++;
+    }
+
+    // links found, as {distance, low index, high index}
+    vector<tuple<double, int, int> > links;
+
+    while (nComponents > 1) {
+        // group precincts by component
+        map<int, vector<int> > members;
+        for (int i = 0; i < keys.size(); i++) members[FindRoot(parents, i)].push_back(i);
+
+        auto largest = max_element(members.begin(), members.end(), [](auto& a, auto& b) {
+            return a.second.size() < b.second.size();
+        });
+
+        vector<tuple<double, int, int> > closest;
+
+        for (auto& component : members) {
+            if (component.first == largest->first) continue;
+            tuple<double, int, int> best(INFINITY, -1, -1);
+
+            for (int i : component.second) {
+                // find the closest center outside this component
+                int root = component.first;
+                vector<IndexedPoint> nearest;
+                centerIndex.query(
+                    boost::geometry::index::nearest(centers[i].first, 1) &&
+                    boost::geometry::index::satisfies([&](const IndexedPoint& p) {
+                        return FindRoot(parents, p.second) != root;
+                    }),
+                    back_inserter(nearest)
+                );
+
+                if (nearest.empty()) continue;
+                int j = nearest[0].second;
+                Point2d a(centers[i].first.x(), centers[i].first.y());
+                Point2d b(centers[j].first.x(), centers[j].first.y());
+                best = min(best, make_tuple(GetDistance(a, b), min(i, j), max(i, j)));
+            }
+
+            if (get<1>(best) != -1) closest.push_back(best);
+        }
+
+        // join closest pairs, skipping links made redundant
+        // by a shorter link found in the same round
+        sort(closest.begin(), closest.end());
+        for (auto& link : closest) {
+            int a = FindRoot(parents, get<1>(link)), b = FindRoot(parents, get<2>(link));
+            if (a == b) continue;
+
+            parents[a] = b;
+            links.push_back(link);
+            nComponents--;
+        }
+    }
+
+    // add links shortest first
+    sort(links.begin(), links.end());
+    for (auto& link : links) {
+        graph.addEdge({keys[get<1>(link)], keys[get<2>(link)]});
+    }
+}
+
+
 /**
  * \brief Determines the network graph of a given precinct group
  * 
  * Given a list of precincts, determines their connection network
  * and links islands.
- * \param pg: A Precinct_Group to get graph of
+ * \param state: A state with precinct attributes to get graph of
+ * \param method: How to find bordering precincts
+ * \param threads: Workers for bordering checks, or 0 for one per core
  * \return: A graph of the connection network
 */
-Graph GenerateGraph(PrecinctGroup pg) {
+Graph GenerateGraph(State& state, AdjacencyMethod method, int threads) {
     // assign all precincts to be nodes
+    PrecinctGroup& pg = state;
     Graph graph;
 
     for (int i = 0; i < pg.precincts.size(); i++) {
@@ -736,75 +1310,329 @@ Graph GenerateGraph(PrecinctGroup pg) {
         graph.vertices[n.id] = n;
     }
 
-    // get bounding boxes for border-checks
-    vector<BoundingBox> boundingBoxes;
-    for (Precinct p : pg.precincts) {
-        boundingBoxes.push_back(p.getBoundingBox());
+    // add bordering precincts as edges to the graph
+    if (method == AdjacencyMethod::SEGMENTS) AddSegmentEdges(graph, state);
+    else AddClippedEdges(graph, state, threads);
+
+    // link components with closest precincts
+    if (graph.getNumComponents() > 1) LinkIslands(graph);
+
+    return graph;
+}
+
+
+LinearRing BoundToRing(BoundingBox box) {
+    return (LinearRing({{box[3], box[0]}, {box[3], box[1]}, {box[2], box[1]}, {box[2], box[0]}}));
+}
+
+
+/**
+ * \brief A boundary segment of a census block
+ * 
+ * Endpoints are packed into single keys and ordered, so
+ * segments shared by two blocks have equal keys
+ */
+struct BlockSegment {
+    uint64_t a, b;
+    int block;
+
+    bool operator<(const BlockSegment& other) const {
+        return tie(a, b, block) < tie(other.a, other.b, other.block);
     }
+};
 
-    // add bordering precincts as edges to the graph
-    for (int i = 0; i < pg.precincts.size(); i++) {
-        // check all unique combinations of precincts with get_bordering
-        for (int j = i + 1; j < pg.precincts.size(); j++) {
-            // check bounding box overlapping
-            if (GetBoundOverlap(boundingBoxes[i], boundingBoxes[j])) {
-                // check clip because bounding boxes overlap
-                if (GetBordering(pg.precincts[i], pg.precincts[j])) {
-                    graph.addEdge({j, i});
+
+/**
+ * \brief Packs points into single keys, as 32 bit offsets from an origin
+ * 
+ * The origin is the first point packed, as the points of a state are
+ * only known once they've all been streamed. Block segments are keyed
+ * by their packed endpoints, so keys must never wrap.
+ * 
+ * \throw Exceptions::CoordinateOverflow if a point is more than a
+ * 32 bit range from the origin
+ */
+class PointPacker {
+    public:
+        uint64_t pack(const Point2d& point) {
+            if (!hasOrigin) {
+                origin = point;
+                hasOrigin = true;
+            }
+
+            long x = point.x - origin.x, y = point.y - origin.y;
+            if (x < INT32_MIN || x > INT32_MAX || y < INT32_MIN || y > INT32_MAX)
+                throw Exceptions::CoordinateOverflow();
+
+            return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+        }
+
+        Point2d unpack(uint64_t key) const {
+            // reverse of `pack`
+            return {origin.x + static_cast<int32_t>(key >> 32), origin.y + static_cast<int32_t>(key & 0xffffffff)};
+        }
+
+    private:
+        Point2d origin = {0, 0};
+        bool hasOrigin = false;
+};
+
+
+string GetProperty(const Value& properties, const string& key) {
+    // gets a string or integer property of a feature as a string
+    if (!properties.HasMember(key.c_str())) return "";
+    const Value& value = properties[key.c_str()];
+
+    if (value.IsString()) return value.GetString();
+    if (value.IsInt64()) return std::to_string(value.GetInt64());
+    return "";
+}
+
+
+CensusBlocks StreamCensusBlocks(string path, vector<BlockSegment>& segments, PointPacker& packer) {
+    /*
+        @desc:
+            Streams census blocks from a geojson file, keeping only
+            each block's id, population, area and centroid. The
+            boundary segments of every block are added to `segments`
+            so bordering blocks can be found once all are read
+
+        @params:
+            `string` path: census block geojson
+            `vector<BlockSegment>&` segments: filled with block boundaries
+            `PointPacker&` packer: packs the endpoints of each segment
+
+        @return: `CensusBlocks` blocks without adjacency
+    */
+
+    CensusBlocks blocks;
+    string idKey = idHeaders.count(IdType::BLOCKID) ? idHeaders[IdType::BLOCKID] : idHeaders[IdType::GEOID];
+    string popKey = idHeaders.count(IdType::BLOCKPOPUID) ? idHeaders[IdType::BLOCKPOPUID] : idHeaders[IdType::POPUID];
+
+    bool texasCoordinates = false;
+    #ifdef TEXAS_COORDS
+        texasCoordinates = true;
+    #endif
+
+    StreamFeatures(path, [&](Value& feature) {
+        if (!feature.HasMember("geometry") || !feature["geometry"].IsObject()) return;
+
+        const Value& coords = feature["geometry"]["coordinates"];
+        MultiPolygon shape;
+
+        if (feature["geometry"]["type"] == "Polygon") {
+            shape.border.resize(1);
+            BuildPolygon(coords, texasCoordinates, shape.border[0]);
+        }
+        else {
+            BuildMultiPolygon(coords, texasCoordinates, shape);
+        }
+
+        int block = blocks.size();
+        double area = 0, x = 0, y = 0;
+
+        for (Polygon& piece : shape.border) {
+            if (piece.hull.border.empty()) continue;
+
+            // weight the centroid of each piece by its area
+            double pieceArea = abs(piece.getSignedArea());
+            BoostPoint2d center;
+            boost::geometry::centroid(RingToBoostPoly(piece.hull), center);
+            area += pieceArea;
+            x += center.x() * pieceArea;
+            y += center.y() * pieceArea;
+
+            piece.holes.push_back(std::move(piece.hull));
+            for (const LinearRing& ring : piece.holes) {
+                for (int i = 0; i + 1 < ring.border.size(); i++) {
+                    uint64_t a = packer.pack(ring.border[i]), b = packer.pack(ring.border[i + 1]);
+                    if (a == b) continue;
+                    if (b < a) swap(a, b);
+                    segments.push_back({a, b, block});
                 }
             }
         }
+
+        Point2d centroid = {0, 0};
+        if (area > 0) centroid = {static_cast<long>(x / area), static_cast<long>(y / area)};
+        else if (!shape.border.empty() && !shape.border[0].holes.empty()) centroid = shape.border[0].holes.back().border[0];
+
+        string pop = GetProperty(feature["properties"], popKey);
+        blocks.ids.push_back(GetProperty(feature["properties"], idKey));
+        blocks.pop.push_back((pop.empty() || !IsNumber(pop)) ? 0 : stoi(pop));
+        blocks.areas.push_back(area);
+        blocks.centroids.push_back(centroid);
+    });
+
+    return blocks;
+}
+
+
+void LinkBlocks(CensusBlocks& blocks, vector<BlockSegment>& segments, const PointPacker& packer) {
+    /*
+        @desc:
+            Finds bordering blocks by sorting their boundary segments
+            so that shared segments are next to each other, and
+            stores the adjacency of `blocks` in compressed sparse rows
+
+        @params:
+            `CensusBlocks&` blocks: blocks to link
+            `vector<BlockSegment>&` segments: boundaries of the blocks, cleared
+            `const PointPacker&` packer: packer of the segments' endpoints
+
+        @return: void
+    */
+
+    sort(segments.begin(), segments.end());
+
+    // each shared segment, in both directions
+    vector<tuple<int, int, double> > borders;
+
+    for (size_t start = 0, end = 0; start < segments.size(); start = end) {
+        end = start + 1;
+        while (end < segments.size() && segments[end].a == segments[start].a && segments[end].b == segments[start].b)
+            end++;
+
+        if (end - start < 2) continue;
+        double length = GetDistance(packer.unpack(segments[start].a), packer.unpack(segments[start].b));
+
+        for (size_t i = start; i < end; i++) {
+            for (size_t j = i + 1; j < end; j++) {
+                if (segments[i].block == segments[j].block) continue;
+                borders.push_back({segments[i].block, segments[j].block, length});
+                borders.push_back({segments[j].block, segments[i].block, length});
+            }
+        }
     }
 
-    // link components with closest precincts
-    if (graph.getNumComponents() > 1) {
-        // determine all centers of precincts
-        std::map<int, Point2d> centers;
-        for (int i = 0; i < graph.vertices.size(); i++) {
-            // add center of precinct to the map
-            int key = (graph.vertices.begin() + i).key();
-            Node pre = (graph.vertices[key]);
-            Point2d center = (graph.vertices.begin() + i).value().precinct->getCentroid();
-            centers.insert({key, center});
-        }
-
-        while (!graph.isConnected()) {
-            // add edges between two precincts on two islands
-            // until `graph` is connected
-            vector<Graph> components = graph.getComponents();
-            Edge shortestPair;
-            double shortestDistance = 100000000000;
-
-            for (size_t i = 0; i < components.size(); i++) {
-                for (size_t j = i + 1; j < components.size(); j++) {
-                    // for each distinct combination of islands
-                    for (size_t p = 0; p < components[i].vertices.size(); p++) {
-                        for (size_t q = 0; q < components[j].vertices.size(); q++) {
-                            // for each distinct precinct combination of the
-                            // two current islands, determine distance between centers
-                            int keyi = (components[i].vertices.begin() + p).key(), keyj = (components[j].vertices.begin() + q).key();
-                            double distance = GetDistance(centers[keyi], centers[keyj]);
-                            
-                            if (distance < shortestDistance) {
-                                shortestDistance = distance;
-                                shortestPair = {keyi, keyj};
-                            }
-                        }
-                    }
-                }
+    vector<BlockSegment>().swap(segments);
+    sort(borders.begin(), borders.end());
+
+    // merge the segments of each pair of blocks into rows
+    blocks.offsets.assign(blocks.size() + 1, 0);
+    blocks.neighbors.clear();
+    blocks.borderLengths.clear();
+
+    for (int i = 0; i < borders.size(); i++) {
+        int from = get<0>(borders[i]), to = get<1>(borders[i]);
+
+        if (i > 0 && get<0>(borders[i - 1]) == from && get<1>(borders[i - 1]) == to) {
+            blocks.borderLengths.back() += get<2>(borders[i]);
+            continue;
+        }
+
+        blocks.neighbors.push_back(to);
+        blocks.borderLengths.push_back(get<2>(borders[i]));
+        blocks.offsets[from + 1]++;
+    }
+
+    partial_sum(blocks.offsets.begin(), blocks.offsets.end(), blocks.offsets.begin());
+}
+
+
+void AssignBlocks(State& state, int threads) {
+    /*
+        @desc:
+            Finds the precinct containing the centroid of each census
+            block, or the closest precinct if none do, and sets the
+            population of each precinct to the total of its blocks
+
+        @params:
+            `State&` state: state with precincts and blocks
+            `int` threads: number of workers, or 0 for one per core
+
+        @return: void
+    */
+
+    CensusBlocks& blocks = state.blocks;
+
+    // index the bounds of each precinct for point queries
+    vector<pair<BoostBox, int> > bounds;
+    vector<ClipperLib::Path> hulls;
+    vector<ClipperLib::Paths> holes(state.precincts.size());
+
+    for (int i = 0; i < state.precincts.size(); i++) {
+        bounds.push_back({BoundingBoxToBoostBox(state.precincts[i].getBoundingBox()), i});
+        hulls.push_back(RingToPath(state.precincts[i].hull));
+        for (LinearRing& hole : state.precincts[i].holes)
+            holes[i].push_back(RingToPath(hole));
+    }
+
+    BoundingBoxIndex boundIndex(bounds.begin(), bounds.end());
+    blocks.precincts.assign(blocks.size(), -1);
+    atomic<int> next(0), nearest(0);
+
+    auto assign = [&]() {
+        vector<pair<BoostBox, int> > candidates;
+        for (int i = next++; i < blocks.size(); i = next++) {
+            BoostPoint2d center(blocks.centroids[i].x, blocks.centroids[i].y);
+            ClipperLib::IntPoint point(blocks.centroids[i].x, blocks.centroids[i].y);
+
+            candidates.clear();
+            boundIndex.query(boost::geometry::index::intersects(center), back_inserter(candidates));
+
+            for (auto& candidate : candidates) {
+                int p = candidate.second;
+                if (ClipperLib::PointInPolygon(point, hulls[p]) == 0) continue;
+
+                bool inHole = false;
+                for (ClipperLib::Path& hole : holes[p])
+                    if (ClipperLib::PointInPolygon(point, hole) == 1) inHole = true;
+
+                if (!inHole && (blocks.precincts[i] == -1 || p < blocks.precincts[i]))
+                    blocks.precincts[i] = p;
             }
 
-            // link the shortest pair
-            graph.addEdge(shortestPair);
+            if (blocks.precincts[i] == -1 && !bounds.empty()) {
+                // centroid is outside every precinct, use the closest
+                candidates.clear();
+                boundIndex.query(boost::geometry::index::nearest(center, 1), back_inserter(candidates));
+                blocks.precincts[i] = candidates[0].second;
+                nearest++;
+            }
         }
-    } // else the graph is linked already
+    };
+
+    int nThreads = threads > 0 ? threads : max(1, static_cast<int>(thread::hardware_concurrency()));
+    vector<thread> workers;
+    for (int t = 1; t < nThreads; t++) workers.emplace_back(assign);
+    assign();
+    for (thread& worker : workers) worker.join();
+
+    // aggregate block population up to precincts
+    for (Precinct& precinct : state.precincts) precinct.pop = 0;
+    for (int i = 0; i < blocks.size(); i++) {
+        if (blocks.precincts[i] != -1) state.precincts[blocks.precincts[i]].pop += blocks.pop[i];
+    }
 
-    return graph;
+    if (VERBOSE) std::cout << nearest << " of " << blocks.size() << " blocks were outside of all precincts" << endl;
 }
 
 
-LinearRing BoundToRing(BoundingBox box) {
-    return (LinearRing({{box[3], box[0]}, {box[3], box[1]}, {box[2], box[1]}, {box[2], box[0]}}));
+void AddCensusBlocks(State& state, const DataParser& options) {
+    /*
+        @desc:
+            Reads the census blocks of a state, links bordering
+            blocks and assigns them to precincts
+
+        @params:
+            `State&` state: state to add blocks to
+            `const DataParser&` options: block file and workers
+
+        @return: void
+    */
+
+    vector<BlockSegment> segments;
+    PointPacker packer;
+
+    if (VERBOSE) std::cout << "streaming census blocks from " << options.blockFile << "..." << endl;
+    state.blocks = StreamCensusBlocks(options.blockFile, segments, packer);
+
+    if (VERBOSE) std::cout << "linking " << state.blocks.size() << " census blocks..." << endl;
+    LinkBlocks(state.blocks, segments, packer);
+
+    if (VERBOSE) std::cout << "aggregating block population into precincts..." << endl;
+    AssignBlocks(state, options.threads);
 }
 
 
@@ -851,10 +1679,110 @@ void ScalePrecinctsToDistrict(State& state) {
             state.precincts[i].hull.border[j].y += tu;
         }
     }
+
+    for (Point2d& centroid : state.blocks.centroids) {
+        centroid.y = centroid.y * scaleRight + tu;
+        centroid.x = centroid.x * scaleTop + tr;
+    }
 }
 
 
-State State::GenerateFromFile(string precinctGeoJSON, string voterData, string districtGeoJSON, map<PoliticalParty, string> pId, map<IdType, string> tId) {
+State BuildState(vector<Precinct>& precincts, vector<MultiPolygon>& districtShapes, const DataParser& options) {
+    /*
+        @desc:
+            Shared final stage of state generation - removes water
+            precincts and holes, scales coordinates and builds the
+            precinct graph.
+
+        @params:
+            `vector<Precinct>&` precincts: parsed precincts with voter data
+            `vector<MultiPolygon>&` districtShapes: parsed district borders
+            `const DataParser&` options: non-precinct ids, adjacency method, blocks, simplification and workers
+
+        @return: `State` parsed state object
+    */
+
+    // remove water precincts from data
+    if (VERBOSE) std::cout << "removing water precincts... ";
+
+    SubstringMatcher nonPrecinct(options.nonPrecinctIds);
+    auto removed = remove_if(precincts.begin(), precincts.end(), [&](const Precinct& p) {
+        return nonPrecinct.matches(p.shapeId);
+    });
+
+    int nRemoved = precincts.end() - removed;
+    precincts.erase(removed, precincts.end());
+
+    if (VERBOSE) std::cout << nRemoved << endl;
+
+    // create a vector of precinct objects from border and voter data
+    PrecinctGroup preGroup(precincts);
+
+    // remove holes from precinct data
+    if (VERBOSE) std::cout << "combining holes in precinct geodata..." << endl;
+    preGroup = CombineHoles(preGroup);
+
+    vector<Polygon> stateShapeVec;  // dummy exterior border
+
+    // generate state data from files
+    if (VERBOSE) std::cout << "generating state with precinct and district arrays..." << endl;
+    State state = State(districtShapes, preGroup.precincts, stateShapeVec);
+    if (!options.blockFile.empty()) AddCensusBlocks(state, options);
+    
+    #ifdef TEXAS_COORDS
+        ScalePrecinctsToDistrict(state);
+    #endif
+
+    // only segment adjacency, border lengths and simplifying use shared arcs
+    if (options.adjacency == AdjacencyMethod::SEGMENTS || options.borderLengths || options.simplifyTolerance > 0) {
+        if (VERBOSE) std::cout << "finding shared arcs of precinct borders..." << endl;
+        state.topology = Topology(state.precincts);
+    }
+
+    if (VERBOSE) std::cout << "computing precinct centroids, areas and bounds..." << endl;
+    state.computeAttributes(options.threads);
+
+    state.network = GenerateGraph(state, options.adjacency, options.threads);
+
+    if (options.borderLengths && options.adjacency == AdjacencyMethod::CLIP) {
+        // segment adjacency records these while finding edges
+        if (VERBOSE) std::cout << "measuring shared borders..." << endl;
+        set<Edge> edges;
+        for (const Edge& edge : state.network.edges)
+            edges.insert({min(edge[0], edge[1]), max(edge[0], edge[1])});
+
+        for (auto& border : state.topology.getBorderLengths())
+            if (edges.count(border.first)) state.network.borderLengths[border.first] = border.second;
+    }
+
+    if (options.simplifyTolerance > 0) {
+        // simplify after adjacency is found, so it uses every point
+        if (VERBOSE) std::cout << "simplifying precinct borders... ";
+        int before = 0, after = 0;
+
+        for (Precinct& precinct : state.precincts) {
+            before += precinct.hull.border.size();
+            for (LinearRing& hole : precinct.holes) before += hole.border.size();
+        }
+
+        state.topology.simplify(options.simplifyTolerance);
+        state.topology.restore(state.precincts);
+        state.computeAttributes(options.threads);
+
+        for (Precinct& precinct : state.precincts) {
+            after += precinct.hull.border.size();
+            for (LinearRing& hole : precinct.holes) after += hole.border.size();
+        }
+
+        if (VERBOSE) std::cout << before << " to " << after << " vertices ("
+                               << (before > 0 ? 100.0 * (before - after) / before : 0) << "% removed)" << endl;
+    }
+
+    return state;
+}
+
+
+State State::GenerateFromFile(const string& precinctGeoJSON, const string& voterData, const string& districtGeoJSON, map<PoliticalParty, string> pId, map<IdType, string> tId, const DataParser& options) {
     /*
         @desc:
             Parse precinct and district geojson, along with
@@ -864,6 +1792,7 @@ State State::GenerateFromFile(string precinctGeoJSON, string voterData, string d
             `string` precinct_geoJSON: A string file with geodata for precincts
             `string` voter_data: A string file with tab separated voter data
             `string` district_geoJSON: A string file with geodata for districts
+            `const DataParser&` options: generation options, input paths are ignored
 
         @return: `State` parsed state object
     */
@@ -873,62 +1802,24 @@ State State::GenerateFromFile(string precinctGeoJSON, string voterData, string d
 
     // generate shapes from coordinates
     if (VERBOSE) std::cout << "generating coordinate arrays..." << endl;
-    vector<Polygon> precinctShapes = ParsePrecinctCoordinates(precinctGeoJSON);
-    vector<MultiPolygon> districtShapes = ParseDistrictCoordinates(districtGeoJSON);
+    vector<Polygon> precinctShapes = ParsePrecinctCoordinates(ParseJson(precinctGeoJSON));
+    vector<MultiPolygon> districtShapes = ParseDistrictCoordinates(ParseJson(districtGeoJSON));
     
     // get voter data from election data file
     if (VERBOSE) std::cout << "parsing voter data from tsv..." << endl;
-    map<string, map<PoliticalParty, int> > precinctVoterData = parseVoterData(voterData);
+    VoterTable precinctVoterData = parseVoterData(voterData);
 
     // create a vector of precinct objects from border and voter data
     if (VERBOSE) std::cout << "merging geodata with voter data into precincts..." << endl;
     vector<Precinct> precincts = MergeData(precinctShapes, precinctVoterData);
-    
-    // remove water precincts from data
-    std::cout << "removing water precincts... ";
-
-    int nRemoved = 0;
-    for (int i = 0; i < precincts.size(); i++) {
-        string id = precincts[i].shapeId;
-        for (string str : nonPrecinctIds) {
-            if (id.find(str) != string::npos) {
-                precincts.erase(precincts.begin() + i);
-                i--;
-                nRemoved++;
-            }
-        }
-    }
 
-    std::cout << nRemoved << endl;
-    PrecinctGroup preGroup(precincts);
-
-    if (VERBOSE) std::cout << "removing holes..." << endl;
-    // remove holes from precinct data
-    preGroup = CombineHoles(preGroup);
-    vector<Polygon> stateShapeVec; // dummy exterior border
-
-    // generate state data from files
-    if (VERBOSE) std::cout << "generating state with precinct and district arrays..." << endl;
-    State state = State(districtShapes, preGroup.precincts, stateShapeVec);
-
-    #ifdef TEXAS_COORDS
-        ScalePrecinctsToDistrict(state);
-    #endif
-
-    std::cout << "getting precinct centroids with boost" << endl;
-    for (int i = 0; i < state.precincts.size(); i++) {
-        BoostPoint2d center;
-        boost::geometry::centroid(RingToBoostPoly(state.precincts[i].hull), center);
-        state.precincts[i].hull.centroid = {center.x(), center.y()};
-    }
-
-    state.network = GenerateGraph(state);
+    State state = BuildState(precincts, districtShapes, options);
     std::cout << "complete!" << endl;
     return state; // return the state object
 }
 
 
-State State::GenerateFromFile(string precinctGeoJSON, string districtGeoJSON, map<PoliticalParty, string> pId, map<IdType, string> tId) {
+State State::GenerateFromFile(const string& precinctGeoJSON, const string& districtGeoJSON, map<PoliticalParty, string> pId, map<IdType, string> tId, const DataParser& options) {
 
     /*
         @desc:
@@ -939,6 +1830,7 @@ State State::GenerateFromFile(string precinctGeoJSON, string districtGeoJSON, ma
             `string` precinct_geoJSON: A string file with geodata for precincts
             `string` voter_data: A string file with tab separated voter data
             `string` district_geoJSON: A string file with geodata for districts
+            `const DataParser&` options: generation options, input paths are ignored
 
         @return: `State` parsed state object
     */
@@ -948,53 +1840,153 @@ State State::GenerateFromFile(string precinctGeoJSON, string districtGeoJSON, ma
 
     // generate shapes from coordinates
     if (VERBOSE) std::cout << "generating coordinate array from precinct file..." << endl;
-    vector<Precinct> precinctShapes = ParsePrecinctData(precinctGeoJSON);
+    vector<Precinct> precinctShapes = ParsePrecinctData(ParseJson(precinctGeoJSON));
     if (VERBOSE) std::cout << "generating coordinate array from district file..." << endl;
-    vector<MultiPolygon> districtShapes = ParseDistrictCoordinates(districtGeoJSON);
+    vector<MultiPolygon> districtShapes = ParseDistrictCoordinates(ParseJson(districtGeoJSON));
 
+    State state = BuildState(precinctShapes, districtShapes, options);
+    if (VERBOSE) std::cout << "state serialized!" << endl;
+    return state; // return the state object
+}
 
-    if (VERBOSE) std::cout << "removing water precincts... ";
-    int nRemoved = 0;
-    for (int i = 0; i < precinctShapes.size(); i++) {
-        string id = precinctShapes[i].shapeId;
-        for (string str : nonPrecinctIds) {
-            if (id.find(str) != string::npos) {
-                precinctShapes.erase(precinctShapes.begin() + i);
-                i--;
-                nRemoved++;
-            }
-        }
-    }
 
-    std::cout << nRemoved << endl;
+State State::GenerateFromFile(MappedFile& precinctGeoJSON, MappedFile& voterData, MappedFile& districtGeoJSON, map<PoliticalParty, string> pId, map<IdType, string> tId, const DataParser& options) {
+    /*
+        @desc:
+            Parse mapped precinct and district geojson, along with
+            precinct voter data, into a State object. The geojson
+            is parsed in place, so each file can only be used once.
+    
+        @params:
+            `MappedFile&` precinctGeoJSON: mapped geodata for precincts
+            `MappedFile&` voterData: mapped tab separated voter data
+            `MappedFile&` districtGeoJSON: mapped geodata for districts
+            `const DataParser&` options: generation options, input paths are ignored
+
+        @return: `State` parsed state object
+    */
+
+    electionHeaders = pId;
+    idHeaders = tId;
 
+    // generate shapes from coordinates
+    if (VERBOSE) std::cout << "generating coordinate arrays..." << endl;
+    vector<Polygon> precinctShapes = ParsePrecinctCoordinates(ParseJson(precinctGeoJSON));
+    vector<MultiPolygon> districtShapes = ParseDistrictCoordinates(ParseJson(districtGeoJSON));
+    
+    // get voter data from election data file
+    if (VERBOSE) std::cout << "parsing voter data from tsv..." << endl;
+    VoterTable precinctVoterData = parseVoterData(string_view(voterData.data(), voterData.size()));
 
     // create a vector of precinct objects from border and voter data
-    PrecinctGroup preGroup(precinctShapes);
+    if (VERBOSE) std::cout << "merging geodata with voter data into precincts..." << endl;
+    vector<Precinct> precincts = MergeData(precinctShapes, precinctVoterData);
 
-    // remove holes from precinct data
-    if (VERBOSE) std::cout << "combining holes in precinct geodata..." << endl;
-    preGroup = CombineHoles(preGroup);
+    State state = BuildState(precincts, districtShapes, options);
+    std::cout << "complete!" << endl;
+    return state; // return the state object
+}
 
-    vector<Polygon> stateShapeVec;  // dummy exterior border
 
-    // generate state data from files
-    if (VERBOSE) std::cout << "generating state with precinct and district arrays..." << endl;
-    State state = State(districtShapes, preGroup.precincts, stateShapeVec);
-    
-    #ifdef TEXAS_COORDS
-        ScalePrecinctsToDistrict(state);
-    #endif
+State State::GenerateFromFile(MappedFile& precinctGeoJSON, MappedFile& districtGeoJSON, map<PoliticalParty, string> pId, map<IdType, string> tId, const DataParser& options) {
+    /*
+        @desc:
+            Parse mapped precinct and district geojson into a State
+            object. The geojson is parsed in place, so each file
+            can only be used once.
 
-    std::cout << "getting centroids of precincst" << endl; 
+        @params:
+            `MappedFile&` precinctGeoJSON: mapped geodata for precincts
+            `MappedFile&` districtGeoJSON: mapped geodata for districts
+            `const DataParser&` options: generation options, input paths are ignored
 
-    for (int i = 0; i < state.precincts.size(); i++) {
-        BoostPoint2d center;
-        boost::geometry::centroid(RingToBoostPoly(state.precincts[i].hull), center);
-        state.precincts[i].hull.centroid = {center.x(), center.y()};
-    }
+        @return: `State` parsed state object
+    */
+
+    electionHeaders = pId;
+    idHeaders = tId;
+
+    // generate shapes from coordinates
+    if (VERBOSE) std::cout << "generating coordinate array from precinct file..." << endl;
+    vector<Precinct> precinctShapes = ParsePrecinctData(ParseJson(precinctGeoJSON));
+    if (VERBOSE) std::cout << "generating coordinate array from district file..." << endl;
+    vector<MultiPolygon> districtShapes = ParseDistrictCoordinates(ParseJson(districtGeoJSON));
 
-    state.network = GenerateGraph(state);
+    State state = BuildState(precinctShapes, districtShapes, options);
     if (VERBOSE) std::cout << "state serialized!" << endl;
     return state; // return the state object
 }
+
+
+string DataParser::getManifest() const {
+    /*
+        @desc:
+            lists the parser version, options and input hashes
+            that determine the state generated by this parser
+
+        @params: none
+        @return: `string` manifest text, one entry per line
+    */
+
+    stringstream manifest;
+    manifest << "version " << VERSION << "\n";
+    manifest << "adjacency " << (adjacency == AdjacencyMethod::SEGMENTS ? "segments" : "clip") << "\n";
+
+    for (auto& id : idHeaders)
+        manifest << "id " << static_cast<int>(id.first) << " " << id.second << "\n";
+    for (auto& party : electionHeaders)
+        manifest << "party " << static_cast<int>(party.first) << " " << party.second << "\n";
+    for (const string& id : nonPrecinctIds)
+        manifest << "nonprecinct " << id << "\n";
+    if (simplifyTolerance > 0)
+        manifest << "simplify " << simplifyTolerance << "\n";
+    if (borderLengths)
+        manifest << "border-lengths\n";
+
+    for (const string& file : {precinctFile, voterFile, districtFile, blockFile}) {
+        if (file.empty()) continue;
+        manifest << "input " << hex << HashFile(file) << dec << " " << file << "\n";
+    }
+
+    return manifest.str();
+}
+
+
+State State::GenerateFromFile(DataParser& parser) {
+    /*
+        @desc:
+            Parse precinct and district geojson, along with optional
+            voter data, into a State object. Geodata is streamed from
+            the parser's file paths one feature at a time.
+
+        @params: `DataParser&` parser: input paths and header keys
+        @return: `State` parsed state object
+    */
+
+    electionHeaders = parser.electionHeaders;
+    idHeaders = parser.idHeaders;
+
+    vector<Precinct> precincts;
+
+    if (parser.voterFile.empty()) {
+        if (VERBOSE) std::cout << "streaming precinct data from " << parser.precinctFile << "..." << endl;
+        precincts = StreamPrecinctData(parser.precinctFile);
+    }
+    else {
+        if (VERBOSE) std::cout << "streaming precinct coordinates from " << parser.precinctFile << "..." << endl;
+        vector<Polygon> precinctShapes = StreamPrecinctCoordinates(parser.precinctFile);
+
+        if (VERBOSE) std::cout << "parsing voter data from tsv..." << endl;
+        VoterTable precinctVoterData = parseVoterData(ReadFile(parser.voterFile));
+
+        if (VERBOSE) std::cout << "merging geodata with voter data into precincts..." << endl;
+        precincts = MergeData(precinctShapes, precinctVoterData);
+    }
+
+    if (VERBOSE) std::cout << "streaming district data from " << parser.districtFile << "..." << endl;
+    vector<MultiPolygon> districtShapes = StreamDistrictCoordinates(parser.districtFile);
+
+    State state = BuildState(precincts, districtShapes, parser);
+    if (VERBOSE) std::cout << "state serialized!" << endl;
+    return state;
+}
@@ -100,6 +100,8 @@ namespace hte {
         for (auto& pair : graph.vertices) {
             state.addPrecinct(*pair.second.precinct);
         }
+
+        state.loadGeometry();
         double districtPopulation = GetPopulationFromMask(state, district);
 
         int largestIndex = -1;
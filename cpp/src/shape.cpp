@@ -13,9 +13,9 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
-#include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/array.hpp>
 #include "../include/hte.h"
@@ -38,6 +38,45 @@ hte::MultiPolygon::MultiPolygon(std::vector<hte::Precinct> s) {
 }
 
 
+void hte::PrecinctGroup::loadGeometry() {
+    // read the rings of any lazily loaded precincts
+    for (Precinct& precinct : precincts) precinct.loadGeometry();
+}
+
+
+double hte::Precinct::getSignedArea() {
+    if (attributes) return attributes->area;
+    loadGeometry();
+    return Polygon::getSignedArea();
+}
+
+
+double hte::Precinct::getPerimeter() {
+    if (attributes) return attributes->perimeter;
+    loadGeometry();
+    return Polygon::getPerimeter();
+}
+
+
+SegmentVec hte::Precinct::getSegments() {
+    loadGeometry();
+    return Polygon::getSegments();
+}
+
+
+BoundingBox hte::Precinct::getBoundingBox() {
+    if (attributes) return attributes->boundingBox;
+    loadGeometry();
+    return Polygon::getBoundingBox();
+}
+
+
+string hte::Precinct::toJson() {
+    loadGeometry();
+    return Polygon::toJson();
+}
+
+
 int hte::PrecinctGroup::getPopulation() {
     int total = 0;
     for (hte::Precinct p : precincts)
@@ -163,6 +202,7 @@ string hte::PrecinctGroup::toJson() {
         @return: `string` json array
     */
 
+    loadGeometry();
     string str = geojsonHeader;
     
     for (hte::Precinct p : precincts) {
@@ -218,20 +258,24 @@ string hte::MultiPolygon::toJson() {
 }
 
 
-void hte::State::toFile(string path) {
-    std::ofstream ofs(path);
-    boost::archive::text_oarchive oa(ofs);
-    oa << *this;
-    return;
-}
+hte::State hte::State::fromTextFile(string path) {
+    /*
+        @desc:
+            reads a state written as a Boost text archive, before
+            states were written as binary files (see storage.cpp)
 
+        @params: `string` path: path to the text archive
+        @return: `State` the state in the archive
+    */
 
-hte::State hte::State::fromFile(string path) {
     State state;
     std::ifstream ifs(path);
     boost::archive::text_iarchive ia(ifs);
     ia >> state;
 
+    // text archives have no derived geometry
+    state.computeAttributes();
+
     for (int i = 0; i < state.network.vertices.size(); i++) {
         state.network.vertices[i].precinct = &state.precincts[i];
     }
@@ -0,0 +1,983 @@
+/*=======================================
+ storage.cpp:                   k-vernooy
+ last modified:               Mon, Jun 22
+
+ Reads and writes states as binary state
+ files: a header, a table of sections and
+ flat arrays of coordinates, adjacency
+ and attributes (see StateSection).
+========================================*/
+
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+// points and boxes are written as they're laid out in memory
+static_assert(sizeof(Point2d) == 2 * sizeof(int64_t), "Point2d must be two 64 bit coordinates");
+static_assert(sizeof(BoundingBox) == 4 * sizeof(int64_t), "BoundingBox must be four 64 bit values");
+
+
+/**
+ * \brief A shared border length as stored in BORDER_LENGTHS
+ */
+struct StoredBorderLength {
+    int32_t a, b;
+    double length;
+};
+
+
+/**
+ * \brief Collects the sections of a binary state file
+ * and writes them with a header and section table
+ */
+class StateFileWriter {
+    public:
+        template<typename T> void add(StateSection id, const vector<T>& values) {
+            sections.push_back({id, string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T))});
+        }
+
+        void add(StateSection id, const vector<string>& strings) {
+            // offsets of each string, followed by their characters
+            vector<int32_t> offsets = {0};
+            for (const string& str : strings) offsets.push_back(offsets.back() + str.size());
+
+            string bytes(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(int32_t));
+            for (const string& str : strings) bytes += str;
+            sections.push_back({id, bytes});
+        }
+
+        void add(StateSection id, const string& bytes) {
+            sections.push_back({id, bytes});
+        }
+
+        void write(string path) const {
+            /*
+                @desc: writes the header, section table and sections
+                @params: `string` path: file to write to
+                @return: `void`
+            */
+
+            StateFileHeader header;
+            memcpy(header.magic, STATE_FILE_MAGIC, sizeof(header.magic));
+            header.version = STATE_FILE_VERSION;
+            header.sections = sections.size();
+
+            // sections start after the table, aligned to 8 bytes
+            vector<StateFileSection> table;
+            uint64_t offset = sizeof(StateFileHeader) + sections.size() * sizeof(StateFileSection);
+
+            for (const auto& section : sections) {
+                offset = (offset + 7) / 8 * 8;
+                table.push_back({section.first, 0, offset, section.second.size()});
+                offset += section.second.size();
+            }
+
+            ofstream ofs(path, ios::binary | ios::trunc);
+            ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            ofs.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(StateFileSection));
+
+            uint64_t position = sizeof(StateFileHeader) + table.size() * sizeof(StateFileSection);
+            for (int i = 0; i < sections.size(); i++) {
+                ofs.write(string(table[i].offset - position, '\0').data(), table[i].offset - position);
+                ofs.write(sections[i].second.data(), sections[i].second.size());
+                position = table[i].offset + sections[i].second.size();
+            }
+
+            ofs.close();
+            if (!ofs) throw Exceptions::FileNotWritten();
+        }
+
+    private:
+        vector<pair<StateSection, string> > sections;
+};
+
+
+map<StateSection, StateFileSection> ReadSectionTable(const char* data, size_t size) {
+    /*
+        @desc: checks the header of a binary state file and reads its section table
+        @params:
+            `const char*` data: contents of the file
+            `size_t` size: size of the file
+
+        @return: `map<StateSection, StateFileSection>` each section in the file
+    */
+
+    StateFileHeader header;
+    if (size < sizeof(header)) throw Exceptions::StateFileInvalid();
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, STATE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version > STATE_FILE_VERSION)
+        throw Exceptions::StateFileInvalid();
+
+    if (size < sizeof(header) + static_cast<uint64_t>(header.sections) * sizeof(StateFileSection))
+        throw Exceptions::StateFileInvalid();
+
+    map<StateSection, StateFileSection> sections;
+    for (int i = 0; i < header.sections; i++) {
+        StateFileSection section;
+        memcpy(&section, data + sizeof(header) + i * sizeof(StateFileSection), sizeof(section));
+        if (section.offset > size || section.size > size - section.offset || section.offset % 8 != 0)
+            throw Exceptions::StateFileInvalid();
+        sections[section.id] = section;
+    }
+
+    return sections;
+}
+
+
+/**
+ * \brief Finds the sections of a binary state file in memory
+ *
+ * Sections that aren't in the file read as empty, so
+ * files written before a section existed still load.
+ */
+class StateFileReader {
+    public:
+        StateFileReader(const char* data, size_t size) : data(data), sections(ReadSectionTable(data, size)) {}
+
+        template<typename T> vector<T> get(StateSection id) const {
+            auto section = sections.find(id);
+            if (section == sections.end()) return {};
+            if (section->second.size % sizeof(T) != 0) throw Exceptions::StateFileInvalid();
+
+            vector<T> values(section->second.size / sizeof(T));
+            memcpy(values.data(), data + section->second.offset, section->second.size);
+            return values;
+        }
+
+        vector<string> getStrings(StateSection id, int count) const {
+            // read `count` strings written by `StateFileWriter::add`
+            auto section = sections.find(id);
+            if (section == sections.end()) return vector<string>(count);
+
+            size_t table = (count + 1) * sizeof(int32_t);
+            if (section->second.size < table) throw Exceptions::StateFileInvalid();
+
+            vector<int32_t> offsets(count + 1);
+            memcpy(offsets.data(), data + section->second.offset, table);
+            if (offsets.back() != section->second.size - table) throw Exceptions::StateFileInvalid();
+
+            const char* chars = data + section->second.offset + table;
+            vector<string> strings(count);
+            for (int i = 0; i < count; i++) {
+                if (offsets[i] > offsets[i + 1]) throw Exceptions::StateFileInvalid();
+                strings[i] = string(chars + offsets[i], offsets[i + 1] - offsets[i]);
+            }
+
+            return strings;
+        }
+
+        string getBytes(StateSection id) const {
+            auto section = sections.find(id);
+            if (section == sections.end()) return "";
+            return string(data + section->second.offset, section->second.size);
+        }
+
+        bool has(StateSection id) const { return sections.count(id) > 0; }
+
+    private:
+        const char* data;
+        map<StateSection, StateFileSection> sections;
+};
+
+
+void CheckOffsets(const vector<int32_t>& offsets, int count, size_t total) {
+    // offsets of `count` items into an array of `total` values
+    if (offsets.size() != count + 1 || offsets[0] != 0 || offsets.back() != total)
+        throw Exceptions::StateFileInvalid();
+
+    for (int i = 0; i < count; i++)
+        if (offsets[i] > offsets[i + 1]) throw Exceptions::StateFileInvalid();
+}
+
+
+Topology ReadTopology(const StateFileReader& file, int n) {
+    /*
+        @desc:
+            reads and checks the shared arcs of a binary state
+            file, so every ring of every precinct can be rebuilt
+            from them with `Topology::getRing`
+
+        @params:
+            `const StateFileReader&` file: the state file
+            `int` n: number of precincts in the file
+
+        @return: `Topology` the arcs and rings in the file
+    */
+
+    Topology topology;
+    topology.arcs = CompactCoordinates::decode(file.getBytes(StateSection::ARCS));
+    int nArcs = topology.arcs.size();
+
+    vector<int32_t> arcPrecincts = file.get<int32_t>(StateSection::ARC_PRECINCTS);
+    vector<int32_t> ringArcOffsets = file.get<int32_t>(StateSection::RING_ARC_OFFSETS);
+    vector<int32_t> ringArcs = file.get<int32_t>(StateSection::RING_ARCS);
+    vector<int32_t> ringStarts = file.get<int32_t>(StateSection::RING_STARTS);
+    vector<int32_t> precinctRingOffsets = file.get<int32_t>(StateSection::PRECINCT_RING_OFFSETS);
+    vector<int32_t> precinctRings = file.get<int32_t>(StateSection::PRECINCT_RINGS);
+
+    int nRings = ringStarts.size();
+    if (arcPrecincts.size() != 2 * nArcs) throw Exceptions::StateFileInvalid();
+    CheckOffsets(ringArcOffsets, nRings, ringArcs.size());
+    CheckOffsets(precinctRingOffsets, n, precinctRings.size());
+
+    for (int32_t arc : ringArcs)
+        if ((arc < 0 ? ~arc : arc) >= nArcs) throw Exceptions::StateFileInvalid();
+    for (int32_t ring : precinctRings)
+        if (ring < 0 || ring >= nRings) throw Exceptions::StateFileInvalid();
+    for (int32_t precinct : arcPrecincts)
+        if (precinct < -1 || precinct >= n) throw Exceptions::StateFileInvalid();
+
+    for (int r = 0; r < nRings; r++) {
+        // a ring kept whole is one arc, traced forwards
+        int nArcRefs = ringArcOffsets[r + 1] - ringArcOffsets[r];
+        if (ringStarts[r] < -1 || nArcRefs == 0 || (ringStarts[r] == -1 && (nArcRefs != 1 || ringArcs[ringArcOffsets[r]] < 0)))
+            throw Exceptions::StateFileInvalid();
+
+        topology.rings.emplace_back(ringArcs.begin() + ringArcOffsets[r], ringArcs.begin() + ringArcOffsets[r + 1]);
+    }
+
+    topology.ringStarts.assign(ringStarts.begin(), ringStarts.end());
+
+    // a split ring starts at one of the points its joined arcs trace
+    for (int r = 0; r < nRings; r++)
+        if (ringStarts[r] != -1 && ringStarts[r] >= topology.getRingSize(r) - 1) throw Exceptions::StateFileInvalid();
+
+    for (int a = 0; a < nArcs; a++)
+        topology.arcPrecincts.push_back({arcPrecincts[2 * a], arcPrecincts[2 * a + 1]});
+
+    for (int i = 0; i < n; i++)
+        topology.precinctRings.emplace_back(precinctRings.begin() + precinctRingOffsets[i], precinctRings.begin() + precinctRingOffsets[i + 1]);
+
+    return topology;
+}
+
+
+bool TopologyMatches(const Topology& topology, const vector<Precinct>& precincts) {
+    // whether the topology still has each precinct's rings, by their sizes
+    if (topology.arcs.size() == 0 || topology.precinctRings.size() != precincts.size()) return false;
+
+    for (int i = 0; i < precincts.size(); i++) {
+        const vector<int>& rings = topology.precinctRings[i];
+        if (rings.size() != precincts[i].holes.size() + 1 || topology.getRingSize(rings[0]) != precincts[i].hull.border.size())
+            return false;
+
+        for (int h = 0; h < precincts[i].holes.size(); h++)
+            if (topology.getRingSize(rings[h + 1]) != precincts[i].holes[h].border.size()) return false;
+    }
+
+    return true;
+}
+
+
+void hte::State::toFile(string path) {
+    /*
+        @desc:
+            writes the state as a binary state file. Precinct rings
+            are stored as the arcs of the topology when the state has
+            one, or else as 32 bit offsets from the least coordinates,
+            as in `CompactCoordinates`. Everything else is stored as
+            flat arrays that load with a single copy
+
+        @params: `string` path: path to write to
+        @return: `void`
+    */
+
+    StateFileWriter file;
+    int n = precincts.size();
+
+    // precinct ids, populations and voter data columns
+    vector<string> ids(n);
+    vector<int32_t> pop(n), parts(n);
+    set<PoliticalParty> partySet;
+
+    for (int i = 0; i < n; i++) {
+        ids[i] = precincts[i].shapeId;
+        pop[i] = precincts[i].pop;
+        parts[i] = precincts[i].isPartOfMultiPolygon;
+        for (const auto& votes : precincts[i].voterData) partySet.insert(votes.first);
+    }
+
+    vector<int32_t> parties, voterData;
+    for (PoliticalParty party : partySet) {
+        parties.push_back(static_cast<int32_t>(party));
+        for (int i = 0; i < n; i++) {
+            auto votes = precincts[i].voterData.find(party);
+            voterData.push_back(votes == precincts[i].voterData.end() ? INT32_MIN : votes->second);
+        }
+    }
+
+    file.add(StateSection::PRECINCT_IDS, ids);
+    file.add(StateSection::PRECINCT_POP, pop);
+    file.add(StateSection::PRECINCT_PARTS, parts);
+    file.add(StateSection::VOTER_PARTIES, parties);
+    file.add(StateSection::VOTER_DATA, voterData);
+
+    // precinct rings, hull first and then holes. States with a
+    // topology store only its arcs, which the rings are rebuilt from
+    bool arcRings = TopologyMatches(topology, precincts);
+
+    if (!arcRings) {
+        vector<Point2dVec> lines;
+        vector<int32_t> ringOffsets = {0};
+
+        for (const Precinct& precinct : precincts) {
+            lines.push_back(precinct.hull.border);
+            for (const LinearRing& hole : precinct.holes) lines.push_back(hole.border);
+            ringOffsets.push_back(lines.size());
+        }
+
+        CompactCoordinates rings(lines);
+        lines.clear();
+        lines.shrink_to_fit();
+
+        file.add(StateSection::RING_OFFSETS, ringOffsets);
+        file.add(StateSection::RING_ORIGIN, vector<Point2d>{rings.origin});
+        file.add(StateSection::RING_POINT_OFFSETS, rings.offsets);
+        file.add(StateSection::RING_POINTS, rings.coords);
+    }
+
+    // precinct graph, keeping the order of nodes and edges
+    vector<int32_t> nodeIds, edgeOffsets = {0}, nodeEdges, edges;
+    for (auto it = network.vertices.begin(); it != network.vertices.end(); ++it) {
+        nodeIds.push_back(it->first);
+        for (const Edge& edge : it->second.edges) nodeEdges.push_back(edge[1]);
+        edgeOffsets.push_back(nodeEdges.size());
+    }
+
+    for (const Edge& edge : network.edges) {
+        edges.push_back(edge[0]);
+        edges.push_back(edge[1]);
+    }
+
+    vector<StoredBorderLength> borderLengths;
+    for (const auto& border : network.borderLengths)
+        borderLengths.push_back({border.first[0], border.first[1], border.second});
+
+    file.add(StateSection::NODE_IDS, nodeIds);
+    file.add(StateSection::NODE_EDGE_OFFSETS, edgeOffsets);
+    file.add(StateSection::NODE_EDGES, nodeEdges);
+    file.add(StateSection::EDGES, edges);
+    file.add(StateSection::BORDER_LENGTHS, borderLengths);
+
+    // derived geometry columns
+    if (attributes.size() == n) {
+        vector<Point2d> centroids(n), hullPoints;
+        vector<double> areas(n), perimeters(n);
+        vector<BoundingBox> boxes(n);
+        vector<int32_t> hullOffsets = {0};
+
+        for (int i = 0; i < n; i++) {
+            centroids[i] = attributes[i].centroid;
+            areas[i] = attributes[i].area;
+            perimeters[i] = attributes[i].perimeter;
+            boxes[i] = attributes[i].boundingBox;
+            hullPoints.insert(hullPoints.end(), attributes[i].convexHull.border.begin(), attributes[i].convexHull.border.end());
+            hullOffsets.push_back(hullPoints.size());
+        }
+
+        file.add(StateSection::ATTRIBUTE_CENTROIDS, centroids);
+        file.add(StateSection::ATTRIBUTE_AREAS, areas);
+        file.add(StateSection::ATTRIBUTE_PERIMETERS, perimeters);
+        file.add(StateSection::ATTRIBUTE_BOUNDING_BOXES, boxes);
+        file.add(StateSection::ATTRIBUTE_HULL_OFFSETS, hullOffsets);
+        file.add(StateSection::ATTRIBUTE_HULL_POINTS, hullPoints);
+    }
+
+    // district borders
+    vector<string> districtIds;
+    vector<int32_t> polygonOffsets = {0}, districtRingOffsets = {0}, pointOffsets = {0};
+    vector<Point2d> points;
+
+    for (const MultiPolygon& district : districts) {
+        districtIds.push_back(district.shapeId);
+        for (const Polygon& polygon : district.border) {
+            points.insert(points.end(), polygon.hull.border.begin(), polygon.hull.border.end());
+            pointOffsets.push_back(points.size());
+
+            for (const LinearRing& hole : polygon.holes) {
+                points.insert(points.end(), hole.border.begin(), hole.border.end());
+                pointOffsets.push_back(points.size());
+            }
+
+            districtRingOffsets.push_back(pointOffsets.size() - 1);
+        }
+
+        polygonOffsets.push_back(districtRingOffsets.size() - 1);
+    }
+
+    file.add(StateSection::DISTRICT_IDS, districtIds);
+    file.add(StateSection::DISTRICT_POLYGON_OFFSETS, polygonOffsets);
+    file.add(StateSection::DISTRICT_RING_OFFSETS, districtRingOffsets);
+    file.add(StateSection::DISTRICT_POINT_OFFSETS, pointOffsets);
+    file.add(StateSection::DISTRICT_POINTS, points);
+
+    // census blocks, already stored as columns
+    if (blocks.size() > 0) {
+        file.add(StateSection::BLOCK_IDS, blocks.ids);
+        file.add(StateSection::BLOCK_POP, vector<int32_t>(blocks.pop.begin(), blocks.pop.end()));
+        file.add(StateSection::BLOCK_CENTROIDS, blocks.centroids);
+        file.add(StateSection::BLOCK_AREAS, blocks.areas);
+        file.add(StateSection::BLOCK_PRECINCTS, vector<int32_t>(blocks.precincts.begin(), blocks.precincts.end()));
+        file.add(StateSection::BLOCK_OFFSETS, vector<int32_t>(blocks.offsets.begin(), blocks.offsets.end()));
+        file.add(StateSection::BLOCK_NEIGHBORS, vector<int32_t>(blocks.neighbors.begin(), blocks.neighbors.end()));
+        file.add(StateSection::BLOCK_BORDER_LENGTHS, blocks.borderLengths);
+    }
+
+    // shared arcs of the precinct borders, in place of their rings
+    if (arcRings) {
+        vector<int32_t> arcPrecincts, ringArcOffsets = {0}, ringArcs, precinctRingOffsets = {0}, precinctRings;
+
+        for (const array<int, 2>& arc : topology.arcPrecincts) {
+            arcPrecincts.push_back(arc[0]);
+            arcPrecincts.push_back(arc[1]);
+        }
+
+        for (const vector<int>& ring : topology.rings) {
+            ringArcs.insert(ringArcs.end(), ring.begin(), ring.end());
+            ringArcOffsets.push_back(ringArcs.size());
+        }
+
+        for (const vector<int>& rings : topology.precinctRings) {
+            precinctRings.insert(precinctRings.end(), rings.begin(), rings.end());
+            precinctRingOffsets.push_back(precinctRings.size());
+        }
+
+        file.add(StateSection::ARCS, topology.arcs.encode());
+        file.add(StateSection::ARC_PRECINCTS, arcPrecincts);
+        file.add(StateSection::RING_ARC_OFFSETS, ringArcOffsets);
+        file.add(StateSection::RING_ARCS, ringArcs);
+        file.add(StateSection::RING_STARTS, vector<int32_t>(topology.ringStarts.begin(), topology.ringStarts.end()));
+        file.add(StateSection::PRECINCT_RING_OFFSETS, precinctRingOffsets);
+        file.add(StateSection::PRECINCT_RINGS, precinctRings);
+    }
+
+    file.write(path);
+}
+
+
+hte::State hte::State::fromFile(string path, LoadMode mode) {
+    /*
+        @desc:
+            reads a binary state file written by `toFile`. Files
+            without the binary header are read as legacy text archives
+
+        @params:
+            `string` path: path to the state file
+            `LoadMode` mode: which parts of the file to read
+
+        @return: `State` the state in the file
+    */
+
+    char magic[sizeof(STATE_FILE_MAGIC)] = {};
+    std::ifstream(path, ios::binary).read(magic, sizeof(magic));
+    if (memcmp(magic, STATE_FILE_MAGIC, sizeof(magic)) != 0) return State::fromTextFile(path);
+
+    return State::fromView(make_shared<const StateView>(path), mode);
+}
+
+
+hte::State hte::State::fromSharedMemory(string name, LoadMode mode) {
+    /*
+        @desc:
+            reads a state published to shared memory by
+            `StateView::publish`, see `fromView`
+
+        @params:
+            `string` name: name of the shared memory segment
+            `LoadMode` mode: which parts of the state to read
+
+        @return: `State` the published state
+    */
+
+    return State::fromView(StateView::attach(name), mode);
+}
+
+
+hte::State hte::State::fromView(shared_ptr<const StateView> view, LoadMode mode) {
+    /*
+        @desc:
+            reads a state from a mapped binary state file. Lazily
+            loaded precincts keep a reference to the view, and read
+            their rings from it the first time they're used
+
+        @params:
+            `shared_ptr<const StateView>` view: the mapped state
+            `LoadMode` mode: which parts of the state to read
+
+        @return: `State` the state in the view
+    */
+
+    StateFileReader file(view->getData().data(), view->getData().size());
+    State state;
+
+    // precinct ids, populations and voter data
+    vector<int32_t> pop = file.get<int32_t>(StateSection::PRECINCT_POP);
+    int n = pop.size();
+
+    vector<string> ids = file.getStrings(StateSection::PRECINCT_IDS, n);
+    vector<int32_t> parts = file.get<int32_t>(StateSection::PRECINCT_PARTS);
+    vector<int32_t> parties = file.get<int32_t>(StateSection::VOTER_PARTIES);
+    vector<int32_t> voterData = file.get<int32_t>(StateSection::VOTER_DATA);
+    if (parts.size() != n || voterData.size() != parties.size() * n) throw Exceptions::StateFileInvalid();
+
+    bool lazy = (mode == LoadMode::LAZY_GEOMETRY);
+
+    // precinct rings, from the shared arcs if the file has them
+    vector<int32_t> ringOffsets;
+    CompactCoordinates rings;
+
+    if (lazy) {
+        if (view->size() != n) throw Exceptions::StateFileInvalid();
+    }
+    else if (file.has(StateSection::ARCS)) state.topology = view->topology;  // checked when it was mapped
+    else {
+        ringOffsets = file.get<int32_t>(StateSection::RING_OFFSETS);
+        vector<Point2d> origin = file.get<Point2d>(StateSection::RING_ORIGIN);
+        rings.offsets = file.get<int32_t>(StateSection::RING_POINT_OFFSETS);
+        rings.coords = file.get<int32_t>(StateSection::RING_POINTS);
+        if (origin.size() != 1 || rings.offsets.empty()) throw Exceptions::StateFileInvalid();
+
+        rings.origin = origin[0];
+        CheckOffsets(ringOffsets, n, rings.size());
+        CheckOffsets(rings.offsets, rings.size(), rings.coords.size() / 2);
+    }
+
+    state.precincts.resize(n);
+    for (int i = 0; i < n; i++) {
+        Precinct& precinct = state.precincts[i];
+        precinct.shapeId = ids[i];
+        precinct.pop = pop[i];
+        precinct.isPartOfMultiPolygon = parts[i];
+
+        for (int p = 0; p < parties.size(); p++)
+            if (voterData[p * n + i] != INT32_MIN)
+                precinct.voterData[static_cast<PoliticalParty>(parties[p])] = voterData[p * n + i];
+
+        if (lazy) {
+            precinct.geometrySource = view;
+            precinct.geometryIndex = i;
+            continue;
+        }
+
+        if (!state.topology.precinctRings.empty()) {
+            const vector<int>& precinctRings = state.topology.precinctRings[i];
+            for (int k = 0; k < precinctRings.size(); k++) {
+                if (k == 0) precinct.hull.border = state.topology.getRing(precinctRings[k]).border;
+                else precinct.holes.push_back(state.topology.getRing(precinctRings[k]));
+            }
+
+            continue;
+        }
+
+        for (int r = ringOffsets[i]; r < ringOffsets[i + 1]; r++) {
+            if (r == ringOffsets[i]) precinct.hull.border = rings.getLine(r);
+            else precinct.holes.push_back(LinearRing(rings.getLine(r)));
+        }
+    }
+
+    // precinct graph
+    vector<int32_t> nodeIds = file.get<int32_t>(StateSection::NODE_IDS);
+    vector<int32_t> edgeOffsets = file.get<int32_t>(StateSection::NODE_EDGE_OFFSETS);
+    vector<int32_t> nodeEdges = file.get<int32_t>(StateSection::NODE_EDGES);
+    vector<int32_t> edges = file.get<int32_t>(StateSection::EDGES);
+    CheckOffsets(edgeOffsets, nodeIds.size(), nodeEdges.size());
+
+    // node ids are the precinct indices, each used once, and
+    // every edge is between two of them
+    if (nodeIds.size() != n || edges.size() % 2 != 0) throw Exceptions::StateFileInvalid();
+    vector<bool> seen(n, false);
+    for (int32_t id : nodeIds) {
+        if (id < 0 || id >= n || seen[id]) throw Exceptions::StateFileInvalid();
+        seen[id] = true;
+    }
+
+    for (const vector<int32_t>* ids : {&nodeEdges, &edges})
+        for (int32_t id : *ids)
+            if (id < 0 || id >= n) throw Exceptions::StateFileInvalid();
+
+    for (int k = 0; k < nodeIds.size(); k++) {
+        Node node;
+        node.id = nodeIds[k];
+        for (int e = edgeOffsets[k]; e < edgeOffsets[k + 1]; e++)
+            node.edges.push_back({node.id, nodeEdges[e]});
+
+        state.network.vertices[node.id] = node;
+    }
+
+    for (int e = 0; e + 1 < edges.size(); e += 2)
+        state.network.edges.push_back({edges[e], edges[e + 1]});
+
+    for (const StoredBorderLength& border : file.get<StoredBorderLength>(StateSection::BORDER_LENGTHS))
+        state.network.borderLengths[{border.a, border.b}] = border.length;
+
+    // derived geometry, computed again if it wasn't stored
+    vector<Point2d> centroids = file.get<Point2d>(StateSection::ATTRIBUTE_CENTROIDS);
+    vector<double> areas = file.get<double>(StateSection::ATTRIBUTE_AREAS);
+    vector<double> perimeters = file.get<double>(StateSection::ATTRIBUTE_PERIMETERS);
+    vector<BoundingBox> boxes = file.get<BoundingBox>(StateSection::ATTRIBUTE_BOUNDING_BOXES);
+    vector<int32_t> hullOffsets = file.get<int32_t>(StateSection::ATTRIBUTE_HULL_OFFSETS);
+    vector<Point2d> hullPoints = file.get<Point2d>(StateSection::ATTRIBUTE_HULL_POINTS);
+    if (hullOffsets.empty()) hullOffsets.assign(n + 1, 0);
+
+    if (centroids.size() == n && areas.size() == n && perimeters.size() == n && boxes.size() == n) {
+        CheckOffsets(hullOffsets, n, hullPoints.size());
+        state.attributes.resize(n);
+
+        for (int i = 0; i < n; i++) {
+            PrecinctAttributes& attr = state.attributes[i];
+            attr.centroid = centroids[i];
+            attr.area = areas[i];
+            attr.perimeter = perimeters[i];
+            attr.boundingBox = boxes[i];
+            attr.convexHull.border.assign(hullPoints.begin() + hullOffsets[i], hullPoints.begin() + hullOffsets[i + 1]);
+        }
+
+        // precincts use the stored values, even without their rings
+        state.applyAttributes();
+    }
+    else {
+        state.loadGeometry();
+        state.computeAttributes();
+    }
+
+    // district borders
+    vector<int32_t> polygonOffsets = file.get<int32_t>(StateSection::DISTRICT_POLYGON_OFFSETS);
+    vector<int32_t> districtRingOffsets = file.get<int32_t>(StateSection::DISTRICT_RING_OFFSETS);
+    vector<int32_t> pointOffsets = file.get<int32_t>(StateSection::DISTRICT_POINT_OFFSETS);
+    vector<Point2d> points = file.get<Point2d>(StateSection::DISTRICT_POINTS);
+
+    int nDistricts = max(0, static_cast<int>(polygonOffsets.size()) - 1);
+    vector<string> districtIds = file.getStrings(StateSection::DISTRICT_IDS, nDistricts);
+    CheckOffsets(polygonOffsets, nDistricts, districtRingOffsets.size() - 1);
+    CheckOffsets(districtRingOffsets, districtRingOffsets.size() - 1, pointOffsets.size() - 1);
+    CheckOffsets(pointOffsets, pointOffsets.size() - 1, points.size());
+
+    for (int d = 0; d < nDistricts; d++) {
+        MultiPolygon district;
+        district.shapeId = districtIds[d];
+
+        for (int p = polygonOffsets[d]; p < polygonOffsets[d + 1]; p++) {
+            Polygon polygon;
+            for (int r = districtRingOffsets[p]; r < districtRingOffsets[p + 1]; r++) {
+                LinearRing ring(Point2dVec(points.begin() + pointOffsets[r], points.begin() + pointOffsets[r + 1]));
+                if (r == districtRingOffsets[p]) polygon.hull = ring;
+                else polygon.holes.push_back(ring);
+            }
+
+            district.border.push_back(polygon);
+        }
+
+        state.districts.push_back(district);
+    }
+
+    // census blocks, which have no geometry to leave unread
+    vector<int32_t> blockPop = file.get<int32_t>(StateSection::BLOCK_POP);
+    if (!blockPop.empty()) {
+        CensusBlocks& blocks = state.blocks;
+        int nBlocks = blockPop.size();
+
+        blocks.ids = file.getStrings(StateSection::BLOCK_IDS, nBlocks);
+        blocks.pop.assign(blockPop.begin(), blockPop.end());
+        blocks.centroids = file.get<Point2d>(StateSection::BLOCK_CENTROIDS);
+        blocks.areas = file.get<double>(StateSection::BLOCK_AREAS);
+
+        vector<int32_t> values = file.get<int32_t>(StateSection::BLOCK_PRECINCTS);
+        blocks.precincts.assign(values.begin(), values.end());
+        values = file.get<int32_t>(StateSection::BLOCK_OFFSETS);
+        blocks.offsets.assign(values.begin(), values.end());
+        values = file.get<int32_t>(StateSection::BLOCK_NEIGHBORS);
+        blocks.neighbors.assign(values.begin(), values.end());
+        blocks.borderLengths = file.get<double>(StateSection::BLOCK_BORDER_LENGTHS);
+
+        CheckOffsets(vector<int32_t>(blocks.offsets.begin(), blocks.offsets.end()), nBlocks, blocks.neighbors.size());
+        if (blocks.centroids.size() != nBlocks || blocks.areas.size() != nBlocks || blocks.precincts.size() != nBlocks
+            || blocks.borderLengths.size() != blocks.neighbors.size())
+            throw Exceptions::StateFileInvalid();
+    }
+
+    for (int i = 0; i < n; i++) {
+        auto node = state.network.vertices.find(i);
+        if (node != state.network.vertices.end()) node.value().precinct = &state.precincts[i];
+    }
+
+    return state;
+}
+
+
+void hte::Precinct::loadGeometry() {
+    /*
+        @desc:
+            reads the hull and holes of a lazily loaded precinct from
+            its state file, then drops its reference to the file
+
+        @params: none
+        @return: `void`
+    */
+
+    if (!geometrySource) return;
+    const StateView& view = *geometrySource;
+
+    hull.border.clear();
+    holes.clear();
+
+    for (int i = 0; i < view.getRingCount(geometryIndex); i++) {
+        if (i == 0) hull.border = view.getRing(geometryIndex, i).border;
+        else holes.push_back(view.getRing(geometryIndex, i));
+    }
+
+    geometrySource.reset();
+    geometryIndex = -1;
+}
+
+
+LinearRing hte::Precinct::getHull() const {
+    /*
+        @desc:
+            gets the hull of the precinct. A lazily loaded precinct
+            reads it from its state file each time, leaving the
+            precinct without rings of its own
+
+        @params: none
+        @return: `LinearRing` the hull
+    */
+
+    if (!geometrySource) return hull;
+    if (geometrySource->getRingCount(geometryIndex) == 0) return LinearRing();
+    return geometrySource->getRing(geometryIndex, 0);
+}
+
+
+StateView::StateView(string path) {
+    // maps a binary state file, see `map`
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw Exceptions::FileNotMapped();
+    map(fd);
+}
+
+
+shared_ptr<const StateView> StateView::attach(string name) {
+    // maps a state published to shared memory, see `map`
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) throw Exceptions::FileNotMapped();
+
+    shared_ptr<StateView> view(new StateView());
+    view->map(fd);
+    return view;
+}
+
+
+void StateView::publish(string path, string name) {
+    /*
+        @desc:
+            copies a binary state file into a new POSIX shared memory
+            segment, for worker processes to `attach` to. A segment
+            left with the same name is unlinked first, which leaves
+            views already attached to it intact
+
+        @params:
+            `string` path: path to the binary state file
+            `string` name: name of the segment, starting with `/`
+
+        @return: `void`
+    */
+
+    MappedFile file(path);
+    if (file.size() < sizeof(STATE_FILE_MAGIC) || memcmp(file.data(), STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC)) != 0)
+        throw Exceptions::StateFileInvalid();
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) throw Exceptions::FileNotMapped();
+
+    if (ftruncate(fd, file.size()) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw Exceptions::FileNotMapped();
+    }
+
+    void* region = mmap(NULL, file.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (region == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw Exceptions::FileNotMapped();
+    }
+
+    memcpy(region, file.data(), file.size());
+    munmap(region, file.size());
+}
+
+
+void StateView::unpublish(string name) {
+    // views already attached keep their mapping until they're destroyed
+    shm_unlink(name.c_str());
+}
+
+
+void StateView::map(int fd) {
+    /*
+        @desc:
+            maps a binary state file or shared memory segment read
+            only and points each span at its section. Only the header
+            and section table are read, other pages are faulted in as
+            they're used
+
+        @params: `int` fd: descriptor of the file, closed once mapped
+        @return: `void`
+    */
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw Exceptions::FileNotMapped();
+    }
+
+    size_ = info.st_size;
+    void* region = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) throw Exceptions::FileNotMapped();
+    data_ = static_cast<char*>(region);
+
+    try {
+        for (const auto& section : ReadSectionTable(data_, size_))
+            sections_[section.first] = Span<char>(data_ + section.second.offset, section.second.size);
+
+        // sections are aligned to 8 bytes, so they can be viewed in place
+        auto view = [&](auto& span, StateSection id) {
+            typedef typename remove_reference<decltype(span)>::type::value_type T;
+            Span<char> bytes = getSection(id);
+            if (bytes.size() % sizeof(T) != 0 || reinterpret_cast<uintptr_t>(bytes.data()) % alignof(T) != 0)
+                throw Exceptions::StateFileInvalid();
+            span = Span<T>(reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T));
+        };
+
+        view(pop, StateSection::PRECINCT_POP);
+        view(voterParties, StateSection::VOTER_PARTIES);
+        view(voterData, StateSection::VOTER_DATA);
+        view(nodeIds, StateSection::NODE_IDS);
+        view(edgeOffsets, StateSection::NODE_EDGE_OFFSETS);
+        view(neighbors, StateSection::NODE_EDGES);
+        view(centroids, StateSection::ATTRIBUTE_CENTROIDS);
+        view(areas, StateSection::ATTRIBUTE_AREAS);
+        view(perimeters, StateSection::ATTRIBUTE_PERIMETERS);
+        view(boundingBoxes, StateSection::ATTRIBUTE_BOUNDING_BOXES);
+
+        // check the ends of each index, and that its entries never decrease,
+        // so every ring and node reads inside its section. Points and
+        // neighbours themselves aren't read
+        int n = size();
+        if (voterData.size() != voterParties.size() * n
+            || edgeOffsets.size() != nodeIds.size() + 1 || edgeOffsets[nodeIds.size()] != neighbors.size()
+            || getSection(StateSection::PRECINCT_IDS).size() < (n + 1) * sizeof(int32_t))
+            throw Exceptions::StateFileInvalid();
+
+        // rings stored as arcs can't be read in place, so the
+        // arcs are decoded once and each ring rebuilt from them
+        if (sections_.count(StateSection::ARCS) > 0) topology = ReadTopology(StateFileReader(data_, size_), n);
+        else {
+            view(ringOffsets, StateSection::RING_OFFSETS);
+            view(pointOffsets, StateSection::RING_POINT_OFFSETS);
+            view(points, StateSection::RING_POINTS);
+
+            Span<char> originBytes = getSection(StateSection::RING_ORIGIN);
+            if (originBytes.size() != sizeof(Point2d) || ringOffsets.size() != n + 1 || pointOffsets.empty()
+                || ringOffsets[n] != pointOffsets.size() - 1 || points.size() != 2 * static_cast<size_t>(pointOffsets[pointOffsets.size() - 1]))
+                throw Exceptions::StateFileInvalid();
+            memcpy(&origin, originBytes.data(), sizeof(Point2d));
+        }
+
+        for (const Span<int32_t>* offsets : {&ringOffsets, &pointOffsets, &edgeOffsets}) {
+            if (offsets->empty()) continue;
+            if ((*offsets)[0] != 0) throw Exceptions::StateFileInvalid();
+            for (size_t i = 1; i < offsets->size(); i++)
+                if ((*offsets)[i] < (*offsets)[i - 1]) throw Exceptions::StateFileInvalid();
+        }
+
+        // the same for the id offsets, which end where the characters do
+        Span<char> ids = getSection(StateSection::PRECINCT_IDS);
+        size_t table = (n + 1) * sizeof(int32_t);
+        int32_t previous = 0;
+
+        for (int i = 0; i <= n; i++) {
+            int32_t offset;
+            memcpy(&offset, ids.data() + i * sizeof(int32_t), sizeof(int32_t));
+            if ((i == 0 && offset != 0) || offset < previous) throw Exceptions::StateFileInvalid();
+            previous = offset;
+        }
+
+        if (previous != ids.size() - table) throw Exceptions::StateFileInvalid();
+    }
+    catch (...) {
+        munmap(data_, size_);
+        throw;
+    }
+}
+
+
+StateView::~StateView() {
+    if (data_ != nullptr) munmap(data_, size_);
+}
+
+
+Span<char> StateView::getSection(StateSection id) const {
+    auto section = sections_.find(id);
+    return (section == sections_.end()) ? Span<char>() : section->second;
+}
+
+
+string_view StateView::getPrecinctId(int precinct) const {
+    // ids are stored as a table of offsets followed by their characters
+    const char* ids = getSection(StateSection::PRECINCT_IDS).data();
+    int32_t start, end;
+    memcpy(&start, ids + precinct * sizeof(int32_t), sizeof(int32_t));
+    memcpy(&end, ids + (precinct + 1) * sizeof(int32_t), sizeof(int32_t));
+    return string_view(ids + (size() + 1) * sizeof(int32_t) + start, end - start);
+}
+
+
+int StateView::getVotes(int precinct, PoliticalParty party) const {
+    for (int p = 0; p < voterParties.size(); p++) {
+        if (voterParties[p] == static_cast<int32_t>(party)) {
+            int32_t votes = voterData[p * size() + precinct];
+            return (votes == INT32_MIN) ? 0 : votes;
+        }
+    }
+
+    return 0;
+}
+
+
+int StateView::getRingCount(int precinct) const {
+    if (!topology.precinctRings.empty()) return topology.precinctRings[precinct].size();
+    return ringOffsets[precinct + 1] - ringOffsets[precinct];
+}
+
+
+LinearRing StateView::getRing(int precinct, int i) const {
+    // rebuilt from the arcs, or read from the flat ring points
+    if (!topology.precinctRings.empty()) return topology.getRing(topology.precinctRings[precinct][i]);
+
+    int r = ringOffsets[precinct] + i;
+    Point2dVec border;
+    border.reserve(pointOffsets[r + 1] - pointOffsets[r]);
+    for (int k = 2 * pointOffsets[r]; k < 2 * pointOffsets[r + 1]; k += 2)
+        border.push_back({origin.x + points[k], origin.y + points[k + 1]});
+
+    return LinearRing(border);
+}
+
+
+Span<int32_t> StateView::getNeighbors(int node) const {
+    return neighbors.subspan(edgeOffsets[node], edgeOffsets[node + 1] - edgeOffsets[node]);
+}
@@ -0,0 +1,752 @@
+/*=======================================
+ topology.cpp:                  k-vernooy
+ last modified:               Mon, Jun 22
+
+ Builds the shared arc topology of a set
+ of precincts, in the style of TopoJSON,
+ and reads rings, borders and exterior
+ edges back out of it. Arcs are stored
+ as compact 32 bit coordinates.
+========================================*/
+
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+
+struct PointHash {
+    // hash of a point's coordinates, for point lookups
+    size_t operator()(const Point2d& p) const {
+        return std::hash<long>()(p.x) ^ (std::hash<long>()(p.y) * 0x9e3779b97f4a7c15);
+    }
+};
+
+
+bool PointLess(const Point2d& a, const Point2d& b) {
+    // orders points by x, then y
+    return (a.x < b.x || (a.x == b.x && a.y < b.y));
+}
+
+
+CompactCoordinates::CompactCoordinates(const vector<Point2dVec>& lines) : origin(0, 0) {
+    /*
+        @desc: stores lines as offsets from the least coordinates among them
+        @params: `const vector<Point2dVec>&` lines: lines of points to store
+        @return: `CompactCoordinates` compact lines
+    */
+
+    long maxX = 0, maxY = 0;
+    bool first = true;
+    size_t points = 0;
+
+    for (const Point2dVec& line : lines) {
+        points += line.size();
+        for (const Point2d& p : line) {
+            if (first || p.x < origin.x) origin.x = p.x;
+            if (first || p.y < origin.y) origin.y = p.y;
+            if (first || p.x > maxX) maxX = p.x;
+            if (first || p.y > maxY) maxY = p.y;
+            first = false;
+        }
+    }
+
+    if (maxX - origin.x > INT32_MAX || maxY - origin.y > INT32_MAX)
+        throw Exceptions::CoordinateOverflow();
+
+    coords.reserve(2 * points);
+    offsets.reserve(lines.size() + 1);
+    offsets.push_back(0);
+
+    for (const Point2dVec& line : lines) {
+        for (const Point2d& p : line) {
+            coords.push_back(static_cast<int32_t>(p.x - origin.x));
+            coords.push_back(static_cast<int32_t>(p.y - origin.y));
+        }
+
+        offsets.push_back(offsets.back() + line.size());
+    }
+}
+
+
+Point2dVec CompactCoordinates::getLine(int line) const {
+    // the absolute points of a line
+    Point2dVec points;
+    points.reserve(getSize(line));
+    for (int i = 0; i < getSize(line); i++) points.push_back(getPoint(line, i));
+    return points;
+}
+
+
+double CompactCoordinates::getLength(int line) const {
+    // sum of the lengths of a line's segments
+    double length = 0;
+    for (int k = 2 * offsets[line]; k + 2 < 2 * offsets[line + 1]; k += 2)
+        length += hypot(static_cast<double>(coords[k + 2] - coords[k]), static_cast<double>(coords[k + 3] - coords[k + 1]));
+
+    return length;
+}
+
+
+double CompactCoordinates::getShoelaceSum(int line) const {
+    /*
+        @desc:
+            sums the shoelace terms of a line's segments. The sums of
+            the lines making up a closed ring add to twice its signed
+            area, and offsets from a shared origin give the same area
+            as absolute coordinates
+
+        @params: `int` line: index of the line
+        @return: `double` sum of the line's shoelace terms
+    */
+
+    double sum = 0;
+    for (int k = 2 * offsets[line]; k + 2 < 2 * offsets[line + 1]; k += 2)
+        sum += static_cast<int64_t>(coords[k]) * coords[k + 3] - static_cast<int64_t>(coords[k + 1]) * coords[k + 2];
+
+    return sum;
+}
+
+
+BoundingBox CompactCoordinates::getBoundingBox(int line) const {
+    // bounds of a line's points, as {top, bottom, left, right}, or all 0 for an empty line
+    if (offsets[line] == offsets[line + 1]) return {0, 0, 0, 0};
+    int32_t top = coords[2 * offsets[line] + 1], bottom = top;
+    int32_t left = coords[2 * offsets[line]], right = left;
+
+    for (int k = 2 * offsets[line]; k < 2 * offsets[line + 1]; k += 2) {
+        left = min(left, coords[k]);
+        right = max(right, coords[k]);
+        bottom = min(bottom, coords[k + 1]);
+        top = max(top, coords[k + 1]);
+    }
+
+    return {origin.y + top, origin.y + bottom, origin.x + left, origin.x + right};
+}
+
+
+void PutVarint(string& bytes, uint64_t value) {
+    // writes 7 bits at a time, with the high bit set on all but the last byte
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    bytes.push_back(static_cast<char>(value));
+}
+
+
+uint64_t GetVarint(const string& bytes, size_t& pos) {
+    // reads a varint written by `PutVarint`, advancing `pos`
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= bytes.size()) throw Exceptions::StateFileInvalid();
+        uint8_t byte = bytes[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+
+    throw Exceptions::StateFileInvalid();
+}
+
+
+uint64_t ZigZag(int64_t value) {
+    // maps signed values to unsigned, so small negatives stay small
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+
+int64_t UnZigZag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+
+string CompactCoordinates::encode() const {
+    /*
+        @desc:
+            encodes the origin, the number of points in each line and
+            the difference of each point from the one before it, as
+            varints. Neighbouring points are close, so most take
+            two or three bytes
+
+        @params: none
+        @return: `string` encoded bytes
+    */
+
+    string bytes;
+    bytes.reserve(coords.size() * 2 + offsets.size() + 20);
+    PutVarint(bytes, ZigZag(origin.x));
+    PutVarint(bytes, ZigZag(origin.y));
+    PutVarint(bytes, size());
+
+    int32_t x = 0, y = 0;
+    for (int line = 0; line < size(); line++) {
+        PutVarint(bytes, getSize(line));
+        for (int k = 2 * offsets[line]; k < 2 * offsets[line + 1]; k += 2) {
+            PutVarint(bytes, ZigZag(static_cast<int64_t>(coords[k]) - x));
+            PutVarint(bytes, ZigZag(static_cast<int64_t>(coords[k + 1]) - y));
+            x = coords[k];
+            y = coords[k + 1];
+        }
+    }
+
+    return bytes;
+}
+
+
+CompactCoordinates CompactCoordinates::decode(const string& bytes) {
+    // reads coordinates written by `encode`
+    CompactCoordinates compact;
+    size_t pos = 0;
+    compact.origin.x = UnZigZag(GetVarint(bytes, pos));
+    compact.origin.y = UnZigZag(GetVarint(bytes, pos));
+
+    // every line takes at least a byte, and every point two
+    uint64_t lines = GetVarint(bytes, pos);
+    if (lines > bytes.size() - pos) throw Exceptions::StateFileInvalid();
+    compact.offsets.reserve(lines + 1);
+    compact.offsets.push_back(0);
+
+    int64_t x = 0, y = 0;
+    for (int line = 0; line < lines; line++) {
+        uint64_t points = GetVarint(bytes, pos);
+        if (points > (bytes.size() - pos) / 2) throw Exceptions::StateFileInvalid();
+        for (int i = 0; i < points; i++) {
+            x += UnZigZag(GetVarint(bytes, pos));
+            y += UnZigZag(GetVarint(bytes, pos));
+            compact.coords.push_back(static_cast<int32_t>(x));
+            compact.coords.push_back(static_cast<int32_t>(y));
+        }
+
+        compact.offsets.push_back(compact.offsets.back() + points);
+    }
+
+    return compact;
+}
+
+
+size_t HashArc(const Point2dVec& arc) {
+    // hash of every point in an arc, in order
+    size_t h = 0;
+    PointHash pointHash;
+    for (const Point2d& p : arc) h ^= pointHash(p) + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+    return h;
+}
+
+
+Topology::Topology(const vector<Precinct>& precincts) {
+    /*
+        @desc:
+            Splits every precinct ring into arcs at junctions, points
+            where neighbouring rings stop sharing a border. Arcs that
+            are traced by two rings are stored once, and each ring
+            refers to the arcs it's made of, reversed where needed
+
+        @params: `const vector<Precinct>&` precincts: precincts to build the topology of
+        @return: `Topology` shared arc topology
+    */
+
+    // every ring as a cycle of points, without the closing point
+    vector<Point2dVec> cycles;
+
+    for (int p = 0; p < precincts.size(); p++) {
+        precinctRings.push_back({});
+        precinctRings.back().push_back(cycles.size());
+        cycles.push_back(precincts[p].hull.border);
+
+        for (const LinearRing& hole : precincts[p].holes) {
+            precinctRings.back().push_back(cycles.size());
+            cycles.push_back(hole.border);
+        }
+    }
+
+    // find junctions, where a point's neighbours differ between visits
+    unordered_map<Point2d, pair<Point2d, Point2d>, PointHash> neighbours;
+    unordered_set<Point2d, PointHash> junctions;
+    vector<bool> closed(cycles.size());
+
+    for (int r = 0; r < cycles.size(); r++) {
+        Point2dVec& cycle = cycles[r];
+        closed[r] = (cycle.size() > 3 && cycle.front() == cycle.back());
+        if (!closed[r]) continue;
+        cycle.pop_back();
+
+        for (int i = 0; i < cycle.size(); i++) {
+            Point2d prev = cycle[(i + cycle.size() - 1) % cycle.size()];
+            Point2d next = cycle[(i + 1) % cycle.size()];
+            if (PointLess(next, prev)) swap(prev, next);
+
+            auto found = neighbours.find(cycle[i]);
+            if (found == neighbours.end()) neighbours[cycle[i]] = {prev, next};
+            else if (found->second.first != prev || found->second.second != next) junctions.insert(cycle[i]);
+        }
+    }
+
+    // arcs with the same canonical points, by hash
+    unordered_map<size_t, vector<int> > arcIndex;
+    vector<Point2dVec> arcLines;
+
+    for (int r = 0; r < cycles.size(); r++) {
+        const Point2dVec& cycle = cycles[r];
+        rings.push_back({});
+
+        if (!closed[r]) {
+            // rings too small to split, or left open, are kept whole
+            ringStarts.push_back(-1);
+            rings.back().push_back(arcLines.size());
+            arcLines.push_back(cycle);
+            continue;
+        }
+
+        // start the ring at a junction, or at its least point if it
+        // has none, so rings tracing the same loop split it the same way
+        int start = -1;
+        for (int i = 0; i < cycle.size() && start == -1; i++)
+            if (junctions.count(cycle[i])) start = i;
+
+        bool hasJunction = (start != -1);
+        if (!hasJunction) start = min_element(cycle.begin(), cycle.end(), PointLess) - cycle.begin();
+        ringStarts.push_back(start);
+
+        Point2dVec arc = {cycle[start]};
+        for (int k = 1; k <= cycle.size(); k++) {
+            const Point2d& point = cycle[(start + k) % cycle.size()];
+            arc.push_back(point);
+            if (k < cycle.size() && (!hasJunction || !junctions.count(point))) continue;
+
+            // use the least of the two directions of the arc as its key
+            Point2dVec reversed(arc.rbegin(), arc.rend());
+            bool isReversed = lexicographical_compare(reversed.begin(), reversed.end(), arc.begin(), arc.end(), PointLess);
+            const Point2dVec& canonical = isReversed ? reversed : arc;
+
+            vector<int>& matches = arcIndex[HashArc(canonical)];
+            int id = -1;
+            for (int match : matches)
+                if (arcLines[match] == canonical) id = match;
+
+            if (id == -1) {
+                id = arcLines.size();
+                arcLines.push_back(canonical);
+                matches.push_back(id);
+            }
+
+            rings.back().push_back(isReversed ? ~id : id);
+            arc = {point};
+        }
+    }
+
+    arcs = CompactCoordinates(arcLines);
+
+    // record the precincts on either side of each arc
+    arcPrecincts.assign(arcs.size(), {-1, -1});
+    for (int p = 0; p < precinctRings.size(); p++) {
+        for (int r : precinctRings[p]) {
+            for (int ref : rings[r]) {
+                array<int, 2>& sides = arcPrecincts[ref < 0 ? ~ref : ref];
+                if (sides[0] == -1) sides[0] = p;
+                else if (sides[1] == -1 && sides[0] != p) sides[1] = p;
+            }
+        }
+    }
+}
+
+
+LinearRing Topology::getRing(int ring) const {
+    /*
+        @desc: rebuilds the closed points of a ring from its arcs
+        @params: `int` ring: index of the ring
+        @return: `LinearRing` the ring's points, as they were originally
+    */
+
+    LinearRing result;
+    if (ringStarts[ring] == -1) {
+        result.border = arcs.getLine(rings[ring][0]);
+        return result;
+    }
+
+    // join the arcs, dropping the point each shares with the last
+    Point2dVec cycle;
+    for (int ref : rings[ring]) {
+        int arc = (ref < 0 ? ~ref : ref);
+        int n = arcs.getSize(arc);
+        for (int k = (cycle.empty() ? 0 : 1); k < n; k++)
+            cycle.push_back(arcs.getPoint(arc, ref < 0 ? n - 1 - k : k));
+    }
+
+    // rotate back to the ring's first point and close it
+    cycle.pop_back();
+    rotate(cycle.begin(), cycle.end() - ringStarts[ring], cycle.end());
+    cycle.push_back(cycle.front());
+    result.border = cycle;
+    return result;
+}
+
+
+int Topology::getRingSize(int ring) const {
+    // points `getRing` rebuilds, counting the point each arc shares with the last once
+    if (ringStarts[ring] == -1) return arcs.getSize(rings[ring][0]);
+
+    int size = 0;
+    for (int i = 0; i < rings[ring].size(); i++) {
+        int n = arcs.getSize(rings[ring][i] < 0 ? ~rings[ring][i] : rings[ring][i]);
+        size += (i == 0) ? n : max(n - 1, 0);
+    }
+
+    return size;
+}
+
+
+double Topology::getArcLength(int arc) const {
+    // sum of the lengths of an arc's segments
+    return arcs.getLength(arc);
+}
+
+
+double ClosingSum(const CompactCoordinates& arcs, int line) {
+    // shoelace term from the last point of a line back to its first
+    int n = arcs.getSize(line);
+    if (n < 2) return 0;
+
+    Point2d last = arcs.getPoint(line, n - 1), first = arcs.getPoint(line, 0);
+    return static_cast<double>(last.x - arcs.origin.x) * (first.y - arcs.origin.y)
+         - static_cast<double>(last.y - arcs.origin.y) * (first.x - arcs.origin.x);
+}
+
+
+double Topology::getSignedArea(int precinct) const {
+    /*
+        @desc:
+            gets the area of a precinct's hull minus the area of its
+            holes, as `Polygon::getSignedArea`, from the shoelace sums
+            of its arcs. A reversed arc adds the negative of its sum
+
+        @params: `int` precinct: index of the precinct
+        @return: `double` signed area of the precinct
+    */
+
+    double area = 0;
+    for (int i = 0; i < precinctRings[precinct].size(); i++) {
+        double ringArea = 0;
+        for (int ref : rings[precinctRings[precinct][i]])
+            ringArea += (ref < 0) ? -arcs.getShoelaceSum(~ref) : arcs.getShoelaceSum(ref);
+
+        // rings kept whole may not be closed
+        if (ringStarts[precinctRings[precinct][i]] == -1)
+            ringArea += ClosingSum(arcs, rings[precinctRings[precinct][i]][0]);
+
+        area += (i == 0 ? ringArea : -ringArea) / 2.0;
+    }
+
+    return area;
+}
+
+
+double Topology::getPerimeter(int precinct) const {
+    // total length of the arcs of a precinct's rings
+    double perimeter = 0;
+    for (int ring : precinctRings[precinct])
+        for (int ref : rings[ring]) perimeter += arcs.getLength(ref < 0 ? ~ref : ref);
+
+    return perimeter;
+}
+
+
+vector<PrecinctAttributes> Topology::getAttributes() const {
+    /*
+        @desc:
+            measures the area, perimeter and hull bounds of every
+            precinct straight from the compact arcs, as `getSignedArea`
+            and `getPerimeter`. Each arc is measured once, and the
+            result used by the precincts on both of its sides
+
+        @params: none
+        @return: `vector<PrecinctAttributes>` area, perimeter and bounding box of each precinct
+    */
+
+    vector<double> lengths(arcs.size()), sums(arcs.size());
+    vector<BoundingBox> boxes(arcs.size());
+
+    for (int a = 0; a < arcs.size(); a++) {
+        lengths[a] = arcs.getLength(a);
+        sums[a] = arcs.getShoelaceSum(a);
+        boxes[a] = arcs.getBoundingBox(a);
+    }
+
+    vector<PrecinctAttributes> attributes(precinctRings.size());
+    for (int p = 0; p < precinctRings.size(); p++) {
+        PrecinctAttributes& attr = attributes[p];
+        attr.boundingBox = {0, 0, 0, 0};
+        bool bounded = false;
+
+        for (int i = 0; i < precinctRings[p].size(); i++) {
+            int ring = precinctRings[p][i];
+            double ringArea = (ringStarts[ring] == -1) ? ClosingSum(arcs, rings[ring][0]) : 0;
+
+            for (int ref : rings[ring]) {
+                int arc = (ref < 0 ? ~ref : ref);
+                ringArea += (ref < 0) ? -sums[arc] : sums[arc];
+                attr.perimeter += lengths[arc];
+                if (i > 0 || arcs.getSize(arc) == 0) continue;
+
+                // the hull's bounds, as {top, bottom, left, right}, from its arcs with points
+                const BoundingBox& box = boxes[arc];
+                attr.boundingBox = !bounded ? box : BoundingBox{max(attr.boundingBox[0], box[0]), min(attr.boundingBox[1], box[1]),
+                                                                min(attr.boundingBox[2], box[2]), max(attr.boundingBox[3], box[3])};
+                bounded = true;
+            }
+
+            attr.area += (i == 0 ? ringArea : -ringArea) / 2.0;
+        }
+    }
+
+    return attributes;
+}
+
+
+std::map<Edge, double> Topology::getBorderLengths() const {
+    /*
+        @desc: finds the length of border shared by each pair of precincts
+        @params: none
+        @return: `map<Edge, double>` border length of each {low, high} pair of precincts
+    */
+
+    std::map<Edge, double> lengths;
+    for (int a = 0; a < arcs.size(); a++) {
+        const array<int, 2>& sides = arcPrecincts[a];
+        if (sides[1] == -1) continue;
+        lengths[{min(sides[0], sides[1]), max(sides[0], sides[1])}] += getArcLength(a);
+    }
+
+    return lengths;
+}
+
+
+vector<int> Topology::getExteriorArcs() const {
+    // arcs that border only one precinct, which make up the exterior border
+    vector<int> exterior;
+    for (int a = 0; a < arcs.size(); a++)
+        if (arcPrecincts[a][1] == -1) exterior.push_back(a);
+
+    return exterior;
+}
+
+
+void Topology::restore(vector<Precinct>& precincts) const {
+    /*
+        @desc: fills the hull and holes of each precinct from its rings
+        @params: `vector<Precinct>&` precincts: precincts the topology was built from
+        @return: void
+    */
+
+    for (int p = 0; p < precincts.size() && p < precinctRings.size(); p++) {
+        precincts[p].hull.border = getRing(precinctRings[p][0]).border;
+        precincts[p].holes.resize(precinctRings[p].size() - 1);
+
+        for (int h = 1; h < precinctRings[p].size(); h++)
+            precincts[p].holes[h - 1].border = getRing(precinctRings[p][h]).border;
+    }
+}
+
+
+double GetSegmentDistance(const Point2d& p, const Point2d& a, const Point2d& b) {
+    // distance from `p` to the closest point on segment `ab`
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = 0;
+
+    if (lengthSquared > 0)
+        t = max(0.0, min(1.0, ((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSquared));
+
+    return hypot(p.x - (a.x + t * dx), p.y - (a.y + t * dy));
+}
+
+
+Point2dVec SimplifyArc(const Point2dVec& arc, double tolerance) {
+    /*
+        @desc:
+            Douglas-Peucker simplification of an arc, keeping both
+            endpoints. Closed arcs are first split at the point
+            farthest from their endpoint
+
+        @params:
+            `const Point2dVec&` arc: arc to simplify
+            `double` tolerance: largest distance a removed point may be from the result
+
+        @return: `Point2dVec` simplified arc
+    */
+
+    int n = arc.size();
+    if (n < 3) return arc;
+
+    vector<bool> keep(n, false);
+    keep[0] = keep[n - 1] = true;
+    vector<pair<int, int> > ranges;
+
+    if (arc.front() == arc.back()) {
+        int far = 0;
+        for (int i = 1; i < n - 1; i++)
+            if (GetDistance(arc[0], arc[i]) > GetDistance(arc[0], arc[far])) far = i;
+
+        keep[far] = true;
+        ranges = {{0, far}, {far, n - 1}};
+    }
+    else ranges = {{0, n - 1}};
+
+    while (!ranges.empty()) {
+        auto [first, last] = ranges.back();
+        ranges.pop_back();
+
+        // keep the farthest point from the segment, if it's too far
+        int far = -1;
+        double farDistance = tolerance;
+        for (int i = first + 1; i < last; i++) {
+            double distance = GetSegmentDistance(arc[i], arc[first], arc[last]);
+            if (distance > farDistance) {
+                far = i;
+                farDistance = distance;
+            }
+        }
+
+        if (far != -1) {
+            keep[far] = true;
+            ranges.push_back({first, far});
+            ranges.push_back({far, last});
+        }
+    }
+
+    Point2dVec simplified;
+    for (int i = 0; i < n; i++)
+        if (keep[i]) simplified.push_back(arc[i]);
+
+    return simplified;
+}
+
+
+bool GetSegmentsCross(const Point2d& a, const Point2d& b, const Point2d& c, const Point2d& d) {
+    // whether segments `ab` and `cd` meet anywhere, segments with a shared endpoint never cross
+    if (a == c || a == d || b == c || b == d) return false;
+
+    auto orientation = [](const Point2d& p, const Point2d& q, const Point2d& r) {
+        long double cross = static_cast<long double>(q.x - p.x) * (r.y - p.y) - static_cast<long double>(q.y - p.y) * (r.x - p.x);
+        return (cross > 0) - (cross < 0);
+    };
+
+    auto onSegment = [](const Point2d& p, const Point2d& q, const Point2d& r) {
+        // whether `r`, collinear with `pq`, lies on it
+        return min(p.x, q.x) <= r.x && r.x <= max(p.x, q.x) && min(p.y, q.y) <= r.y && r.y <= max(p.y, q.y);
+    };
+
+    int o1 = orientation(a, b, c), o2 = orientation(a, b, d);
+    int o3 = orientation(c, d, a), o4 = orientation(c, d, b);
+
+    if (o1 != o2 && o3 != o4) return true;
+    return (o1 == 0 && onSegment(a, b, c)) || (o2 == 0 && onSegment(a, b, d)) ||
+           (o3 == 0 && onSegment(c, d, a)) || (o4 == 0 && onSegment(c, d, b));
+}
+
+
+int Topology::simplify(double tolerance) {
+    /*
+        @desc:
+            Simplifies every arc with Douglas-Peucker, keeping the
+            junctions at their ends. Borders shared by two precincts
+            stay identical because they're one arc, and arcs never
+            disappear, so bordering precincts still border. Arcs that
+            would collapse a ring or cross another arc are left as
+            they were
+
+        @params: `double` tolerance: largest distance a removed point may be from the result
+        @return: `int` number of arc points removed
+    */
+
+    vector<Point2dVec> original, lines;
+    for (int a = 0; a < arcs.size(); a++) original.push_back(arcs.getLine(a));
+
+    lines = original;
+    vector<bool> simplified(arcs.size(), false);
+
+    // rings kept whole aren't split into arcs at junctions
+    vector<bool> whole(arcs.size(), false);
+    for (int r = 0; r < rings.size(); r++)
+        if (ringStarts[r] == -1) whole[rings[r][0]] = true;
+
+    for (int a = 0; a < lines.size(); a++) {
+        if (whole[a]) continue;
+        lines[a] = SimplifyArc(original[a], tolerance);
+        simplified[a] = (lines[a].size() < original[a].size());
+    }
+
+    auto revert = [&](int a) {
+        lines[a] = original[a];
+        simplified[a] = false;
+    };
+
+    // keep rings from collapsing to fewer than three points
+    for (int r = 0; r < rings.size(); r++) {
+        if (ringStarts[r] == -1) continue;
+        int points = 0;
+        for (int ref : rings[r]) points += lines[ref < 0 ? ~ref : ref].size() - 1;
+        if (points < 3)
+            for (int ref : rings[r]) revert(ref < 0 ? ~ref : ref);
+    }
+
+    // undo arcs that cross other arcs, until none do
+    typedef pair<BoostBox, pair<int, int> > IndexedSegment;
+    bool crossed = true;
+
+    while (crossed) {
+        crossed = false;
+        vector<IndexedSegment> segments;
+        for (int a = 0; a < lines.size(); a++) {
+            for (int i = 0; i + 1 < lines[a].size(); i++) {
+                const Point2d& p = lines[a][i], & q = lines[a][i + 1];
+                segments.push_back({BoostBox(BoostPoint2d(min(p.x, q.x), min(p.y, q.y)), BoostPoint2d(max(p.x, q.x), max(p.y, q.y))), {a, i}});
+            }
+        }
+
+        boost::geometry::index::rtree<IndexedSegment, boost::geometry::index::rstar<16> > segmentIndex(segments.begin(), segments.end());
+        vector<IndexedSegment> candidates;
+        vector<bool> crossing(lines.size(), false);
+
+        for (const IndexedSegment& segment : segments) {
+            int a = segment.second.first, i = segment.second.second;
+            if (!simplified[a]) continue;
+
+            candidates.clear();
+            segmentIndex.query(boost::geometry::index::intersects(segment.first), back_inserter(candidates));
+
+            for (const IndexedSegment& candidate : candidates) {
+                int b = candidate.second.first, j = candidate.second.second;
+                if (a == b && i == j) continue;
+
+                if (GetSegmentsCross(lines[a][i], lines[a][i + 1], lines[b][j], lines[b][j + 1])) {
+                    crossing[a] = true;
+                    if (simplified[b]) crossing[b] = true;
+                }
+            }
+        }
+
+        for (int a = 0; a < lines.size(); a++) {
+            if (crossing[a]) {
+                revert(a);
+                crossed = true;
+            }
+        }
+    }
+
+    // simplified rings start at their first junction
+    int removed = 0;
+    for (int a = 0; a < lines.size(); a++)
+        removed += original[a].size() - lines[a].size();
+
+    for (int r = 0; r < rings.size(); r++) {
+        for (int ref : rings[r])
+            if (lines[ref < 0 ? ~ref : ref].size() != original[ref < 0 ? ~ref : ref].size()) ringStarts[r] = 0;
+    }
+
+    arcs = CompactCoordinates(lines);
+    return removed;
+}
@@ -6,7 +6,11 @@
  string, and other utilities.
 ========================================*/
 
-#include <regex>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "../include/hte.h"
 
 namespace hte {
@@ -30,6 +34,126 @@ namespace hte {
     };
 
 
+    MappedFile::MappedFile(std::string path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw Exceptions::FileNotMapped();
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw Exceptions::FileNotMapped();
+        }
+
+        // round up to whole pages, leaving room for a null terminator
+        size_ = info.st_size;
+        size_t page = sysconf(_SC_PAGESIZE);
+        mappedSize_ = ((size_ + page) / page) * page;
+
+        // reserve zeroed pages, then map the file over the start of
+        // them so the byte after the contents is always null
+        void* region = mmap(NULL, mappedSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            close(fd);
+            throw Exceptions::FileNotMapped();
+        }
+
+        if (size_ > 0) {
+            if (mmap(region, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                munmap(region, mappedSize_);
+                close(fd);
+                throw Exceptions::FileNotMapped();
+            }
+
+            madvise(region, size_, MADV_SEQUENTIAL);
+        }
+
+        close(fd);
+        data_ = static_cast<char*>(region);
+    }
+
+
+    MappedFile::~MappedFile() {
+        if (data_ != nullptr) munmap(data_, mappedSize_);
+    }
+
+
+    SubstringMatcher::SubstringMatcher(const std::vector<std::string>& patterns) {
+        // build a trie of the patterns, with state 0 as the root
+        next_.push_back({});
+        next_[0].fill(-1);
+        accepting_.push_back(false);
+
+        for (const std::string& pattern : patterns) {
+            // an empty pattern, as from a trailing comma, would match everything
+            if (pattern.empty()) continue;
+
+            int state = 0;
+            for (unsigned char c : pattern) {
+                if (next_[state][c] == -1) {
+                    next_[state][c] = next_.size();
+                    next_.push_back({});
+                    next_.back().fill(-1);
+                    accepting_.push_back(false);
+                }
+
+                state = next_[state][c];
+            }
+
+            accepting_[state] = true;
+        }
+
+        // add failure transitions breadth first, so every
+        // state has a transition for every byte
+        std::vector<int> fail(next_.size(), 0);
+        std::vector<int> queue;
+
+        for (int c = 0; c < 256; c++) {
+            if (next_[0][c] == -1) next_[0][c] = 0;
+            else queue.push_back(next_[0][c]);
+        }
+
+        for (size_t i = 0; i < queue.size(); i++) {
+            int state = queue[i];
+            if (accepting_[fail[state]]) accepting_[state] = true;
+
+            for (int c = 0; c < 256; c++) {
+                int child = next_[state][c];
+                if (child == -1) next_[state][c] = next_[fail[state]][c];
+                else {
+                    fail[child] = next_[fail[state]][c];
+                    queue.push_back(child);
+                }
+            }
+        }
+    }
+
+
+    bool SubstringMatcher::matches(std::string_view str) const {
+        int state = 0;
+        for (unsigned char c : str) {
+            state = next_[state][c];
+            if (accepting_[state]) return true;
+        }
+
+        return false;
+    }
+
+
+    uint64_t HashFile(std::string path) {
+        // FNV-1a over the mapped contents of the file
+        MappedFile file(path);
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (size_t i = 0; i < file.size(); i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+
     void WriteFile(std::string contents, std::string path) {
         std::ofstream of(path);
         of << contents;
@@ -67,9 +191,20 @@ namespace hte {
     }
 
 
-    bool IsNumber(std::string token) {
-        // checks if a string is any number type
-        return regex_match(token, std::regex(("((\\+|-)?[[:digit:]]+)(\\.(([[:digit:]]+)?))?")));
+    bool IsNumber(std::string_view token) {
+        // checks if a string is any number type: an optional
+        // sign, digits, then an optional decimal part
+        size_t i = 0;
+        if (i < token.size() && (token[i] == '+' || token[i] == '-')) i++;
+
+        size_t digits = i;
+        while (i < token.size() && isdigit(static_cast<unsigned char>(token[i]))) i++;
+        if (i == digits) return false;
+
+        if (i < token.size() && token[i] == '.') i++;
+        while (i < token.size() && isdigit(static_cast<unsigned char>(token[i]))) i++;
+
+        return i == token.size();
     }
 
 
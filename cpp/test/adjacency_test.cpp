@@ -0,0 +1,134 @@
+/*=======================================
+ adjacency_test.cpp:            k-vernooy
+ last modified:               Fri, Oct 16
+
+ Checks that segment adjacency finds the
+ same edges as clip adjacency, and that
+ both record the true shared border
+ lengths.
+========================================*/
+
+#include <cstdio>
+#include <set>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+// one degree of district geodata, which precincts are scaled to
+const long UNIT = 1 << 18;
+const int ROWS = 3, COLUMNS = 4;
+
+
+array<long, 2> BrickSpan(int row, int column) {
+    // left and right of a brick, with every other row offset by half a brick
+    long left = (2 * column + row % 2) * UNIT;
+    return {left, left + 2 * UNIT};
+}
+
+
+string BrickFeature(int row, int column) {
+    /*
+        @desc:
+            a brick with a point halfway along its top and bottom,
+            where the bricks of the next rows meet, so that bordering
+            bricks trace each shared border through the same points
+
+        @params: `int` row, column: position of the brick
+        @return: `string` the brick as a geojson feature
+    */
+
+    long x = BrickSpan(row, column)[0], y = row * UNIT;
+    vector<array<long, 2> > points = {
+        {x, y}, {x + UNIT, y}, {x + 2 * UNIT, y}, {x + 2 * UNIT, y + UNIT},
+        {x + UNIT, y + UNIT}, {x, y + UNIT}, {x, y}
+    };
+
+    vector<string> coords;
+    for (auto& point : points) coords.push_back("[" + to_string(point[0]) + "," + to_string(point[1]) + "]");
+
+    return "{\"type\":\"Feature\",\"properties\":{\"id\":\"p" + to_string(row * COLUMNS + column)
+        + "\",\"pop\":100,\"dem\":10},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[["
+        + Join(coords, ",") + "]]}}";
+}
+
+
+map<Edge, double> ExpectedBorders() {
+    // every pair of bricks whose sides overlap, with the length of the overlap
+    map<Edge, double> borders;
+    for (int i = 0; i < ROWS * COLUMNS; i++) {
+        for (int j = i + 1; j < ROWS * COLUMNS; j++) {
+            int ri = i / COLUMNS, rj = j / COLUMNS;
+            array<long, 2> a = BrickSpan(ri, i % COLUMNS), b = BrickSpan(rj, j % COLUMNS);
+
+            if (ri == rj && (a[1] == b[0] || b[1] == a[0])) borders[{i, j}] = UNIT;
+            else if (rj == ri + 1 && min(a[1], b[1]) > max(a[0], b[0])) borders[{i, j}] = min(a[1], b[1]) - max(a[0], b[0]);
+        }
+    }
+
+    return borders;
+}
+
+
+set<Edge> GetEdges(Graph& graph) {
+    // the graph's edges as {low, high} pairs
+    set<Edge> edges;
+    for (const Edge& edge : graph.edges) edges.insert({min(edge[0], edge[1]), max(edge[0], edge[1])});
+    return edges;
+}
+
+
+int main() {
+    const string precinctPath = "adjacency_test_precincts.json";
+    const string districtPath = "adjacency_test_districts.json";
+    bool passed = true;
+
+    vector<string> features;
+    for (int row = 0; row < ROWS; row++)
+        for (int column = 0; column < COLUMNS; column++)
+            features.push_back(BrickFeature(row, column));
+
+    WriteFile("{\"type\":\"FeatureCollection\",\"features\":[" + Join(features, ",") + "]}", precinctPath);
+
+    // a district covering the bricks exactly, in degrees, so precincts aren't rescaled
+    string right = to_string(2 * COLUMNS + 1), top = to_string(ROWS);
+    WriteFile("{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{},"
+        "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[[0,0],[" + right + ",0],[" + right + "," + top
+        + "],[0," + top + "],[0,0]]]}}]}", districtPath);
+
+    map<IdType, string> ids = {{IdType::GEOID, "id"}, {IdType::POPUID, "pop"}};
+    map<PoliticalParty, string> parties = {{PoliticalParty::Democrat, "dem"}};
+
+    DataParser clip(precinctPath, districtPath, parties, ids);
+    clip.borderLengths = true;
+    DataParser segments = clip;
+    segments.adjacency = AdjacencyMethod::SEGMENTS;
+
+    State clipped = State::GenerateFromFile(clip);
+    State matched = State::GenerateFromFile(segments);
+    map<Edge, double> expected = ExpectedBorders();
+
+    set<Edge> expectedEdges;
+    for (auto& border : expected) expectedEdges.insert(border.first);
+
+    if (GetEdges(clipped.network) != expectedEdges) {
+        cout << "clip adjacency found " << clipped.network.edges.size() << " edges, expected " << expected.size() << endl;
+        passed = false;
+    }
+
+    if (GetEdges(matched.network) != GetEdges(clipped.network)) {
+        cout << "segment adjacency found different edges than clip adjacency" << endl;
+        passed = false;
+    }
+
+    if (matched.network.borderLengths != expected || clipped.network.borderLengths != expected) {
+        cout << "border lengths don't match the shared borders" << endl;
+        passed = false;
+    }
+
+    remove(precinctPath.c_str());
+    remove(districtPath.c_str());
+    if (!passed) return 1;
+    cout << "All tests passed!" << endl;
+    return 0;
+}
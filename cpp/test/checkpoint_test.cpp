@@ -0,0 +1,204 @@
+/*=======================================
+ checkpoint_test.cpp:           k-vernooy
+ last modified:               Fri, Oct 16
+
+ Checks that an optimization run killed
+ partway through and resumed from its
+ checkpoint ends with the same communities
+ as a run that was never stopped.
+========================================*/
+
+#include <csignal>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+const int SIDE = 6;
+
+// measures taken before a run kills itself, or -1 to never stop
+int measuresLeft = -1;
+int measuresTaken = 0;
+
+
+void CountMeasure() {
+    // stops the process like a kill from outside, partway through a run
+    measuresTaken++;
+    if (measuresLeft > 0 && --measuresLeft == 0) raise(SIGKILL);
+}
+
+
+double GetBalance(Communities& cs) {
+    // higher for communities of more equal population
+    CountMeasure();
+    double sum = 0;
+    for (Community& c : cs) sum -= pow(c.getPopulation(), 2);
+    return sum;
+}
+
+
+double GetImbalance(Community& c) {
+    // distance from a third of the grid's population
+    CountMeasure();
+    return abs(c.getPopulation() - 30.0);
+}
+
+
+Graph GetGrid(vector<Precinct>& precincts) {
+    /*
+        @desc: builds a graph of square precincts of uneven population
+        @params: `vector<Precinct>&` precincts: filled with the precincts of the nodes
+        @return: `Graph` the grid, with each node bordering the nodes beside it
+    */
+
+    for (int i = 0; i < SIDE * SIDE; i++) {
+        long x = (i % SIDE) * 10, y = (i / SIDE) * 10;
+        LinearRing hull({{x, y}, {x + 10, y}, {x + 10, y + 10}, {x, y + 10}, {x, y}});
+        precincts.push_back(Precinct(hull, 1 + (i * i) % 8, "p" + to_string(i)));
+    }
+
+    Graph graph;
+    for (int i = 0; i < precincts.size(); i++) {
+        Node node(&precincts[i]);
+        node.id = i;
+        graph.vertices[i] = node;
+    }
+
+    for (int i = 0; i < precincts.size(); i++) {
+        for (int j : {i + 1, i + SIDE}) {
+            if (j >= precincts.size() || (j == i + 1 && j % SIDE == 0)) continue;
+            graph.edges.push_back({i, j});
+            graph.vertices[i].edges.push_back({i, j});
+            graph.vertices[j].edges.push_back({j, i});
+        }
+    }
+
+    return graph;
+}
+
+
+Communities GetColumns(Graph& graph) {
+    // one, two and three columns, built like those from `KargerStein`
+    vector<vector<int> > columns(3);
+    for (auto& pair : graph.vertices) {
+        int column = pair.first % SIDE;
+        pair.second.community = (column == 0) ? 0 : (column < 3) ? 1 : 2;
+        columns[pair.second.community].push_back(pair.first);
+    }
+
+    Communities cs(3);
+    for (int i = 0; i < cs.size(); i++) {
+        cs[i].vertices = graph.getInducedSubgraph(columns[i]).vertices;
+        cs[i].resetShape(graph);
+    }
+
+    return cs;
+}
+
+
+vector<int> Optimize(bool annealing, string checkpoint, int interval, int killAfter) {
+    /*
+        @desc: runs an optimizer on a new grid, starting from its columns
+        @params:
+            `bool` annealing: use simulated annealing instead of gradient descent
+            `string` checkpoint: path to save progress to and resume from
+            `int` interval: steps or epochs between checkpoints
+            `int` killAfter: measures to take before the process kills itself, or -1
+
+        @return: `vector<int>` the community of each node when the run finished
+    */
+
+    vector<Precinct> precincts;
+    Graph graph = GetGrid(precincts);
+    Communities cs = GetColumns(graph);
+
+    // the same random numbers for every run
+    srand(1);
+    measuresLeft = killAfter;
+    measuresTaken = 0;
+
+    stringstream output;
+    streambuf* console = cout.rdbuf(output.rdbuf());
+    if (annealing) SimulatedAnnealingOptimization(graph, cs, GetImbalance, checkpoint, interval);
+    else GradientDescentOptimization(graph, cs, GetBalance, checkpoint, interval);
+    cout.rdbuf(console);
+
+    vector<int> assignment;
+    for (auto& pair : graph.vertices) assignment.push_back(pair.second.community);
+    return assignment;
+}
+
+
+bool TestResume(bool annealing, int interval, int killAfter) {
+    /*
+        @desc: kills a run partway through and resumes it from its checkpoint
+        @params:
+            `bool` annealing: test simulated annealing instead of gradient descent
+            `int` interval: steps or epochs between checkpoints
+            `int` killAfter: measures to take before the first run is killed
+
+        @return: `bool` whether the resumed run matched an uninterrupted one
+    */
+
+    string name = annealing ? "annealing" : "gradient descent";
+    string fullPath = "checkpoint_test_full", resumedPath = "checkpoint_test_resumed";
+    remove(fullPath.c_str());
+    remove(resumedPath.c_str());
+
+    vector<int> full = Optimize(annealing, fullPath, interval, -1);
+    int fullMeasures = measuresTaken;
+    OptimizationCheckpoint finished;
+    finished.load(fullPath);
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        Optimize(annealing, resumedPath, interval, killAfter);
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    OptimizationCheckpoint saved;
+    bool killed = WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+
+    if (!killed || !saved.load(resumedPath) || saved.epoch == 0 || saved.epoch >= finished.epoch) {
+        cout << name << " wasn't killed partway through, after a checkpoint" << endl;
+        return false;
+    }
+
+    vector<int> resumed = Optimize(annealing, resumedPath, interval, -1);
+    remove(fullPath.c_str());
+    remove(resumedPath.c_str());
+
+    // a resumed run only measures what's left after its checkpoint
+    if (measuresTaken >= fullMeasures) {
+        cout << name << " started over instead of resuming" << endl;
+        return false;
+    }
+
+    if (resumed != full) {
+        cout << name << " resumed from step " << saved.epoch << " to different communities" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+int main() {
+    bool passed = true;
+
+    // gradient descent measures every exchange of each step
+    if (!TestResume(false, 1, 100)) passed = false;
+
+    // annealing measures each of the three communities every epoch
+    if (!TestResume(true, 1000, 3 * 15500)) passed = false;
+
+    if (!passed) return 1;
+    cout << "All tests passed!" << endl;
+    return 0;
+}
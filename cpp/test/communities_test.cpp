@@ -0,0 +1,147 @@
+/*=======================================
+ communities_test.cpp:          k-vernooy
+ last modified:               Fri, Oct 16
+
+ Checks that saved and exported
+ communities load back onto a graph
+ whose nodes are in a different order,
+ and that damaged files throw.
+========================================*/
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+const int PRECINCTS = 9, COMMUNITIES = 3;
+
+// bytes before the node assignment of a binary communities file
+const int HEADER_SIZE = 24;
+
+
+Graph GetGraph(vector<Precinct>& precincts, bool reversed) {
+    /*
+        @desc: builds a graph with a node for each precinct and no edges
+        @params:
+            `vector<Precinct>&` precincts: precincts of the nodes
+            `bool` reversed: number the nodes in the opposite order
+
+        @return: `Graph` the nodes of the precincts
+    */
+
+    Graph graph;
+    for (int i = 0; i < precincts.size(); i++) {
+        Node node(&precincts[i]);
+        node.id = reversed ? precincts.size() - 1 - i : i;
+        node.community = -1;
+        graph.vertices[node.id] = node;
+    }
+
+    return graph;
+}
+
+
+set<set<string> > GetMembers(Communities& cs) {
+    // the precinct ids of each community
+    set<set<string> > members;
+    for (Community& c : cs) {
+        set<string> ids;
+        for (auto& pair : c.vertices) ids.insert(pair.second.precinct->shapeId);
+        members.insert(ids);
+    }
+
+    return members;
+}
+
+
+int main() {
+    const string path = "communities_test.comms";
+    const string textPath = "communities_test.txt";
+    bool passed = true;
+
+    vector<Precinct> precincts;
+    for (int i = 0; i < PRECINCTS; i++) {
+        long x = i * 10;
+        LinearRing hull({{x, 0}, {x + 10, 0}, {x + 10, 10}, {x, 10}, {x, 0}});
+        precincts.push_back(Precinct(hull, 100, "p" + to_string(i)));
+    }
+
+    Graph graph = GetGraph(precincts, false);
+    Communities cs(COMMUNITIES);
+    for (int i = 0; i < PRECINCTS; i++) cs[i % COMMUNITIES].addNode(graph.vertices[i]);
+
+    SaveCommunitiesToFile(cs, path);
+    ExportCommunitiesToText(cs, textPath);
+
+    for (const string& file : {path, textPath}) {
+        // nodes are matched by precinct id, not by their number
+        Graph reversed = GetGraph(precincts, true);
+        Communities loaded = LoadCommunitiesFromFile(file, reversed);
+
+        if (loaded.size() != COMMUNITIES || GetMembers(loaded) != GetMembers(cs)) {
+            cout << file << " loaded different communities" << endl;
+            passed = false;
+            continue;
+        }
+
+        for (int c = 0; c < loaded.size(); c++) {
+            for (auto& pair : loaded[c].vertices) {
+                if (reversed.vertices[pair.first].community != c) {
+                    cout << file << " didn't assign node " << pair.first << " its community" << endl;
+                    passed = false;
+                }
+            }
+        }
+    }
+
+    // nodes left out of every community lose the one they had before
+    string bytes = ReadFile(path);
+    string unassigned = bytes;
+    int32_t none = -1;
+    memcpy(&unassigned[HEADER_SIZE], &none, sizeof(none));
+    WriteFile(unassigned, path);
+
+    Graph reversed = GetGraph(precincts, true);
+    for (auto it = reversed.vertices.begin(); it != reversed.vertices.end(); ++it) it.value().community = COMMUNITIES;
+    LoadCommunitiesFromFile(path, reversed);
+
+    for (int i = 0; i < PRECINCTS; i++) {
+        int expected = (i == 0) ? -1 : i % COMMUNITIES;
+        if (reversed.vertices[PRECINCTS - 1 - i].community != expected) {
+            cout << "precinct " << i << " kept a community it wasn't assigned" << endl;
+            passed = false;
+        }
+    }
+
+    // damaged files are rejected: an assignment past the last community,
+    // precinct ids cut off, and an exported id without its closing quote
+    string outOfRange = bytes;
+    int32_t past = COMMUNITIES;
+    memcpy(&outOfRange[HEADER_SIZE], &past, sizeof(past));
+
+    string text = ReadFile(textPath);
+    vector<array<string, 2> > damaged = {
+        {path, outOfRange}, {path, bytes.substr(0, bytes.size() - PRECINCTS * 3)},
+        {textPath, text.substr(0, text.find('\'', text.find('\'') + 1))}
+    };
+
+    for (auto& file : damaged) {
+        WriteFile(file[1], file[0]);
+
+        try {
+            LoadCommunitiesFromFile(file[0], reversed);
+            cout << "damaged " << file[0] << " was read" << endl;
+            passed = false;
+        }
+        catch (Exceptions::CommunitiesFileInvalid&) {}
+    }
+
+    remove(path.c_str());
+    remove(textPath.c_str());
+    if (!passed) return 1;
+    cout << "All tests passed!" << endl;
+    return 0;
+}
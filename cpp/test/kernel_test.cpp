@@ -0,0 +1,73 @@
+/*=======================================
+ kernel_test.cpp:               k-vernooy
+ last modified:               Sun, Jun 21
+
+ Checks that the vectorized ring kernels
+ match the scalar ones, including rings
+ too large for the vectorized versions.
+========================================*/
+
+#include <random>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+
+bool CheckRing(const Point2dVec& ring, string name) {
+    /*
+        @desc: compares the vectorized and scalar kernels on a ring
+        @params: `Point2dVec&` ring: points of the ring, `string` name: for failures
+        @return: `bool` whether every kernel matched
+    */
+
+    bool matched = GetShoelaceSum(ring, true) == GetShoelaceSum(ring, false)
+        && GetRingPerimeter(ring, true) == GetRingPerimeter(ring, false)
+        && GetRingBoundingBox(ring, true) == GetRingBoundingBox(ring, false);
+
+    // exact area, in integers relative to the first point
+    __int128 sum = 0;
+    for (int i = 0; i < ring.size(); i++) {
+        const Point2d& a = ring[i];
+        const Point2d& b = ring[(i + 1) % ring.size()];
+        sum += static_cast<__int128>(a.x - ring[0].x) * (b.y - ring[0].y) - static_cast<__int128>(a.y - ring[0].y) * (b.x - ring[0].x);
+    }
+
+    if (abs(static_cast<double>(sum) - GetShoelaceSum(ring)) > 1e-9 * abs(static_cast<double>(sum))) matched = false;
+    if (!matched) cout << "kernel mismatch on " << name << " (" << ring.size() << " points)" << endl;
+    return matched;
+}
+
+
+int main() {
+    cout << "vector kernels " << (HasVectorKernels() ? "enabled" : "unavailable") << endl;
+    mt19937 rng(7);
+    bool passed = true;
+
+    auto randomRing = [&](int n, long span) {
+        Point2dVec ring;
+        for (int i = 0; i < n; i++)
+            ring.push_back({static_cast<long>(rng() % span), static_cast<long>(rng() % span)});
+        return ring;
+    };
+
+    // small and odd sizes, which mostly or entirely miss the vector loop
+    for (int n = 1; n <= 17; n++)
+        passed &= CheckRing(randomRing(n, 1000000), "small ring");
+
+    for (int t = 0; t < 1000; t++)
+        passed &= CheckRing(randomRing(5 + rng() % 400, 3000000), "random ring");
+
+    // one vertex far from the first, at each position of a vector block
+    for (int far = 1; far < 12; far++) {
+        for (long distance : {1L << 27, 1L << 40, 1L << 52}) {
+            Point2dVec ring = randomRing(13, 1000);
+            ring[far].x += distance;
+            passed &= CheckRing(ring, "ring with a far vertex at " + to_string(far));
+        }
+    }
+
+    if (!passed) return 1;
+    cout << "All tests passed!" << endl;
+    return 0;
+}
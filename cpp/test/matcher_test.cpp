@@ -0,0 +1,80 @@
+/*=======================================
+ matcher_test.cpp:              k-vernooy
+ last modified:               Fri, Oct 16
+
+ Checks SubstringMatcher against a plain
+ substring search, and that empty ids
+ don't match every precinct.
+========================================*/
+
+#include <random>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+
+bool Contains(const vector<string>& patterns, const string& str) {
+    // the matcher's answer, found the slow way
+    for (const string& pattern : patterns)
+        if (!pattern.empty() && str.find(pattern) != string::npos) return true;
+
+    return false;
+}
+
+
+int main() {
+    mt19937 rng(7);
+    bool passed = true;
+
+    // the default non-precinct ids, including ones that share prefixes
+    vector<string> ids = DataParser().nonPrecinctIds;
+    SubstringMatcher nonPrecinct(ids);
+
+    for (string id : {"39043043ZZZ", "4500WWWWWW12", "LAKE", "x9999", "3908500799"}) {
+        if (!nonPrecinct.matches(id)) {
+            cout << "didn't match " << id << endl;
+            passed = false;
+        }
+    }
+
+    for (string id : {"", "39043043", "LAK", "999", "WWWWW", "390850079", "p12"}) {
+        if (nonPrecinct.matches(id)) {
+            cout << "matched " << id << endl;
+            passed = false;
+        }
+    }
+
+    // a trailing comma in --non-precinct-ids leaves an empty pattern
+    vector<string> trailing = Split("ZZZ,9999,", ",");
+    SubstringMatcher withEmpty(trailing);
+    if (withEmpty.matches("p12") || !withEmpty.matches("39ZZZ") || SubstringMatcher({""}).matches("p12")) {
+        cout << "empty patterns changed what matched" << endl;
+        passed = false;
+    }
+
+    // random patterns over a small alphabet, so they overlap often
+    auto randomString = [&](int length) {
+        string str;
+        for (int i = 0; i < length; i++) str += "abc"[rng() % 3];
+        return str;
+    };
+
+    for (int t = 0; t < 200; t++) {
+        vector<string> patterns;
+        for (int p = rng() % 5; p >= 0; p--) patterns.push_back(randomString(rng() % 5));
+        SubstringMatcher matcher(patterns);
+
+        for (int s = 0; s < 50; s++) {
+            string str = randomString(rng() % 12);
+            if (matcher.matches(str) != Contains(patterns, str)) {
+                cout << "mismatch on " << str << " with " << Join(patterns, ",") << endl;
+                passed = false;
+            }
+        }
+    }
+
+    if (!passed) return 1;
+    cout << "All tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*=======================================
+ merge_benchmark.cpp:           k-vernooy
+ last modified:               Sun, Jun 21
+
+ Times MergeData on synthetic grids of
+ square precincts, some of which are
+ split into multipolygon pieces, to show
+ how the merge step scales.
+========================================*/
+
+#include <chrono>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+
+vector<Polygon> GeneratePrecincts(int n, VoterTable& voterData) {
+    /*
+        @desc:
+            generates `n` square precincts on a grid, where
+            every tenth precinct is split into three pieces
+
+        @params:
+            `int` n: number of precincts to generate
+            `VoterTable&` voterData: filled with votes for each precinct
+
+        @return: `vector<Polygon>` precinct shapes
+    */
+
+    vector<Polygon> shapes;
+    int side = ceil(sqrt(n));
+    long size = 1000;
+
+    voterData.parties = {PoliticalParty::Democrat, PoliticalParty::Republican};
+    voterData.votes.assign(2, {});
+    voterData.filled.assign(2, vector<char>(n, true));
+
+    for (int i = 0; i < n; i++) {
+        string id = "P" + to_string(i);
+        long x = (i % side) * size, y = (i / side) * size;
+        voterData.ids.push_back(id);
+        voterData.rows[id] = i;
+        for (vector<int>& column : voterData.votes) column.push_back(RandInt(0, 1000));
+
+        int pieces = (i % 10 == 0) ? 3 : 1;
+        long width = size / pieces;
+
+        for (int p = 0; p < pieces; p++) {
+            long left = x + p * width;
+            Polygon shape(LinearRing({
+                {left, y}, {left + width, y}, {left + width, y + size}, {left, y + size}, {left, y}
+            }), id);
+
+            shape.pop = RandInt(0, 5000);
+            if (pieces > 1) shape.isPartOfMultiPolygon = p;
+            shapes.push_back(shape);
+        }
+    }
+
+    return shapes;
+}
+
+
+int main() {
+    for (int n : {1000, 10000, 100000}) {
+        VoterTable voterData;
+        vector<Polygon> shapes = GeneratePrecincts(n, voterData);
+
+        auto start = chrono::steady_clock::now();
+        vector<Precinct> precincts = MergeData(shapes, voterData);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+        cout << n << " precincts (" << shapes.size() << " shapes): "
+             << elapsed.count() << "s, "
+             << elapsed.count() * 1e6 / shapes.size() << "us per shape" << endl;
+    }
+}
@@ -0,0 +1,143 @@
+/*=======================================
+ simplify_test.cpp:             k-vernooy
+ last modified:               Fri, Oct 16
+
+ Checks that simplifying a topology keeps
+ which precincts border each other, and
+ that each shared border stays identical
+ on both of its sides.
+========================================*/
+
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+const long SIZE = 1000;  // side of each precinct
+const int STEPS = 20;    // points along each side
+
+
+Point2dVec WigglySide(Point2d a, Point2d b) {
+    /*
+        @desc:
+            points along a side from `a` to `b`, nudged off the line by
+            a few units. Points depend only on the side, not on its
+            direction, so bordering precincts trace the same points
+
+        @params: `Point2d` a, b: ends of the side
+        @return: `Point2dVec` points from `a` up to, but not including, `b`
+    */
+
+    bool reversed = (b.x < a.x || (b.x == a.x && b.y < a.y));
+    if (reversed) swap(a, b);
+
+    Point2dVec points;
+    for (int k = 0; k < STEPS; k++) {
+        long nudge = (k == 0) ? 0 : ((a.x * 7 + a.y * 13 + k * 31) % 7) - 3;
+        long x = a.x + (b.x - a.x) * k / STEPS, y = a.y + (b.y - a.y) * k / STEPS;
+        if (a.x == b.x) x += nudge;
+        else y += nudge;
+        points.push_back({x, y});
+    }
+
+    if (!reversed) return points;
+
+    // the same points, walked from the other end
+    points.push_back(b);
+    reverse(points.begin(), points.end());
+    points.pop_back();
+    return points;
+}
+
+
+vector<Precinct> WigglyGrid(int side) {
+    // square precincts whose shared sides are wiggly lines
+    vector<Precinct> precincts;
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            Point2dVec corners = {{x * SIZE, y * SIZE}, {(x + 1) * SIZE, y * SIZE}, {(x + 1) * SIZE, (y + 1) * SIZE}, {x * SIZE, (y + 1) * SIZE}};
+            Point2dVec ring;
+
+            for (int c = 0; c < 4; c++) {
+                Point2dVec points = WigglySide(corners[c], corners[(c + 1) % 4]);
+                ring.insert(ring.end(), points.begin(), points.end());
+            }
+
+            ring.push_back(ring.front());
+            precincts.push_back(Precinct(LinearRing(ring), "p" + to_string(x + y * side)));
+        }
+    }
+
+    return precincts;
+}
+
+
+bool SameLengths(const map<Edge, double>& a, const map<Edge, double>& b) {
+    // same bordering pairs, with the same border lengths up to rounding
+    if (a.size() != b.size()) return false;
+    for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+        if (i->first != j->first || abs(i->second - j->second) > 1e-9 * i->second) return false;
+
+    return true;
+}
+
+
+int main() {
+    bool passed = true;
+    vector<Precinct> precincts = WigglyGrid(4);
+
+    Topology topology(precincts);
+    map<Edge, double> before = topology.getBorderLengths();
+    int arcs = topology.arcs.size();
+
+    int removed = topology.simplify(5);
+    if (removed == 0) {
+        cout << "simplifying removed no points" << endl;
+        passed = false;
+    }
+
+    if (topology.arcs.size() != arcs) {
+        cout << "simplifying changed the number of arcs" << endl;
+        passed = false;
+    }
+
+    // the simplified borders keep the same neighbours
+    map<Edge, double> after = topology.getBorderLengths();
+    if (after.size() != before.size()) {
+        cout << "simplifying changed which precincts border" << endl;
+        passed = false;
+    }
+
+    for (auto i = before.begin(), j = after.begin(); i != before.end() && j != after.end(); ++i, ++j) {
+        if (i->first != j->first || j->second > i->second) {
+            cout << "border of " << i->first[0] << " and " << i->first[1] << " wasn't simplified in place" << endl;
+            passed = false;
+        }
+    }
+
+    // rings rebuilt from the simplified arcs trace each shared border
+    // through the same points, so a topology built from them again
+    // finds the same borders, with the same lengths
+    topology.restore(precincts);
+    for (const Precinct& precinct : precincts) {
+        if (precinct.hull.border.size() < 4 || precinct.hull.border.front() != precinct.hull.border.back()) {
+            cout << "precinct " << precinct.shapeId << " lost its ring" << endl;
+            passed = false;
+        }
+    }
+
+    Topology rebuilt(precincts);
+    if (!SameLengths(rebuilt.getBorderLengths(), after)) {
+        cout << "restored rings don't share their simplified borders" << endl;
+        passed = false;
+    }
+
+    if (rebuilt.getExteriorArcs().size() != topology.getExteriorArcs().size()) {
+        cout << "restored rings have a different exterior border" << endl;
+        passed = false;
+    }
+
+    if (!passed) return 1;
+    cout << "All tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*=======================================
+ storage_test.cpp:              k-vernooy
+ last modified:               Fri, Oct 16
+
+ Checks that a state written as a binary
+ state file reads back the same, and that
+ damaged files and failed writes throw.
+========================================*/
+
+#include <cstdio>
+#include <cstring>
+#include "../include/hte.h"
+
+using namespace hte;
+using namespace std;
+
+
+State GridState(int side) {
+    /*
+        @desc: builds a state of square precincts, with a hole in the first
+        @params: `int` side: number of precincts along each side
+        @return: `State` the grid, with a graph, topology, attributes and blocks
+    */
+
+    const long size = 1000;
+    State state;
+
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            long x0 = x * size + 5000000000, y0 = y * size - 3000000000;
+            LinearRing hull({{x0, y0}, {x0 + size, y0}, {x0 + size, y0 + size}, {x0, y0 + size}, {x0, y0}});
+
+            Precinct precinct(hull, 100 + x + y * side, "p" + to_string(x + y * side));
+            precinct.voterData[PoliticalParty::Democrat] = x;
+            if (y % 2 == 0) precinct.voterData[PoliticalParty::Republican] = y;
+
+            if (x == 0 && y == 0)
+                precinct.holes.push_back(LinearRing({{x0 + 10, y0 + 10}, {x0 + 10, y0 + 20}, {x0 + 20, y0 + 20}, {x0 + 20, y0 + 10}, {x0 + 10, y0 + 10}}));
+
+            state.precincts.push_back(precinct);
+        }
+    }
+
+    for (int i = 0; i < state.precincts.size(); i++) {
+        Node node(&state.precincts[i]);
+        node.id = i;
+        state.network.vertices[i] = node;
+    }
+
+    for (int i = 0; i < state.precincts.size(); i++) {
+        for (int j : {i + 1, i + side}) {
+            if (j >= state.precincts.size() || (j == i + 1 && j % side == 0)) continue;
+            state.network.edges.push_back({i, j});
+            state.network.vertices[i].edges.push_back({i, j});
+            state.network.vertices[j].edges.push_back({j, i});
+            state.network.borderLengths[{i, j}] = size;
+        }
+    }
+
+    state.districts.push_back(MultiPolygon({Polygon(state.precincts[0].hull)}, "d0"));
+    state.topology = Topology(state.precincts);
+    state.computeAttributes();
+
+    // one block in each precinct, bordering the ones before and after
+    CensusBlocks& blocks = state.blocks;
+    for (int i = 0; i < state.precincts.size(); i++) {
+        blocks.ids.push_back("b" + to_string(i));
+        blocks.pop.push_back(state.precincts[i].pop);
+        blocks.centroids.push_back(state.attributes[i].centroid);
+        blocks.areas.push_back(state.attributes[i].area);
+        blocks.precincts.push_back(i);
+        blocks.offsets.push_back(blocks.neighbors.size());
+        for (int j : {i - 1, i + 1}) {
+            if (j < 0 || j >= state.precincts.size()) continue;
+            blocks.neighbors.push_back(j);
+            blocks.borderLengths.push_back(size + min(i, j));
+        }
+    }
+
+    blocks.offsets.push_back(blocks.neighbors.size());
+    return state;
+}
+
+
+bool SameBlocks(CensusBlocks& x, CensusBlocks& y) {
+    // compares every column of two sets of blocks
+    return x.ids == y.ids && x.pop == y.pop && x.centroids == y.centroids && x.areas == y.areas
+        && x.precincts == y.precincts && x.offsets == y.offsets && x.neighbors == y.neighbors
+        && x.borderLengths == y.borderLengths;
+}
+
+
+bool SameState(State& a, State& b) {
+    /*
+        @desc: compares everything a binary state file stores
+        @params: `State&` a, b: states to compare
+        @return: `bool` whether the states match
+    */
+
+    if (a.precincts.size() != b.precincts.size() || a.districts.size() != b.districts.size()) return false;
+
+    for (int i = 0; i < a.precincts.size(); i++) {
+        Precinct& p = a.precincts[i];
+        Precinct& q = b.precincts[i];
+        if (p.shapeId != q.shapeId || p.pop != q.pop || p.voterData != q.voterData
+            || !(p.hull == q.hull) || !(p.holes == q.holes))
+            return false;
+
+        PrecinctAttributes& x = a.attributes[i];
+        PrecinctAttributes& y = b.attributes[i];
+        if (x.centroid != y.centroid || x.area != y.area || x.perimeter != y.perimeter
+            || x.boundingBox != y.boundingBox || !(x.convexHull == y.convexHull))
+            return false;
+    }
+
+    for (int d = 0; d < a.districts.size(); d++)
+        if (!(a.districts[d] == b.districts[d]) || a.districts[d].shapeId != b.districts[d].shapeId) return false;
+
+    if (a.network.edges != b.network.edges || a.network.borderLengths != b.network.borderLengths
+        || a.network.vertices.size() != b.network.vertices.size())
+        return false;
+
+    for (int i = 0; i < a.network.vertices.size(); i++)
+        if (a.network.vertices[i].edges != b.network.vertices[i].edges || b.network.vertices[i].precinct != &b.precincts[i])
+            return false;
+
+    if (!SameBlocks(a.blocks, b.blocks)) return false;
+
+    Topology& s = a.topology;
+    Topology& t = b.topology;
+    if (s.arcs.origin != t.arcs.origin || s.arcs.coords != t.arcs.coords || s.arcs.offsets != t.arcs.offsets
+        || s.rings != t.rings || s.ringStarts != t.ringStarts || s.precinctRings != t.precinctRings
+        || s.arcPrecincts != t.arcPrecincts)
+        return false;
+
+    return true;
+}
+
+
+string DamageSection(string bytes, StateSection id, int32_t value) {
+    /*
+        @desc: overwrites the first int32 of a section of a binary state file
+        @params:
+            `string` bytes: contents of the file
+            `StateSection` id: section to damage
+            `int32_t` value: value to write in its place
+
+        @return: `string` the damaged file
+    */
+
+    StateFileHeader header;
+    memcpy(&header, bytes.data(), sizeof(header));
+
+    for (int i = 0; i < header.sections; i++) {
+        StateFileSection section;
+        memcpy(&section, bytes.data() + sizeof(header) + i * sizeof(StateFileSection), sizeof(section));
+        if (section.id == id) memcpy(&bytes[section.offset], &value, sizeof(value));
+    }
+
+    return bytes;
+}
+
+
+int main() {
+    const string path = "storage_test.state";
+    bool passed = true;
+
+    State state = GridState(4);
+    state.toFile(path);
+
+    State full = State::fromFile(path);
+    if (!SameState(state, full)) {
+        cout << "state read back differently" << endl;
+        passed = false;
+    }
+
+    // lazily loaded precincts read the same rings on first use
+    State lazy = State::fromFile(path, LoadMode::LAZY_GEOMETRY);
+    if (lazy.topology.arcs.size() != 0) {
+        cout << "lazy load read the topology" << endl;
+        passed = false;
+    }
+
+    if (!SameBlocks(state.blocks, lazy.blocks)) {
+        cout << "lazy load read different blocks" << endl;
+        passed = false;
+    }
+
+    // blocks form a path, with the border lengths of its rows
+    Graph blockGraph = lazy.blocks.getGraph();
+    if (blockGraph.vertices.size() != state.blocks.size() || blockGraph.edges.size() != state.blocks.size() - 1
+        || blockGraph.vertices[1].edges != vector<Edge>{{1, 0}, {1, 2}} || blockGraph.borderLengths[{2, 3}] != 1002) {
+        cout << "block graph doesn't match the blocks" << endl;
+        passed = false;
+    }
+
+    // hulls of lazy precincts are read without being kept
+    for (int i = 0; i < state.precincts.size(); i++) {
+        if (!(lazy.precincts[i].getHull() == state.precincts[i].hull) || !lazy.precincts[i].geometrySource) {
+            cout << "lazy precinct " << i << " hull wasn't read in place" << endl;
+            passed = false;
+        }
+    }
+
+    for (int i = 0; i < state.precincts.size(); i++) {
+        lazy.precincts[i].loadGeometry();
+        if (!(lazy.precincts[i].hull == state.precincts[i].hull) || !(lazy.precincts[i].holes == state.precincts[i].holes)) {
+            cout << "lazy precinct " << i << " read different rings" << endl;
+            passed = false;
+        }
+    }
+
+    // rings of a state with a topology are stored once, as its arcs,
+    // and states without one keep their flat rings
+    if (!StateView(path).getSection(StateSection::RING_POINTS).empty()) {
+        cout << "rings were stored next to the arcs" << endl;
+        passed = false;
+    }
+
+    const string flatPath = "storage_test_flat.state";
+    State flat = state;
+    flat.topology = Topology();
+    flat.toFile(flatPath);
+
+    State flatFull = State::fromFile(flatPath);
+    State flatLazy = State::fromFile(flatPath, LoadMode::LAZY_GEOMETRY);
+    flatLazy.loadGeometry();
+    if (StateView(flatPath).getSection(StateSection::RING_POINTS).empty() || !SameState(flat, flatFull)
+        || !(flatLazy.precincts[0].hull == state.precincts[0].hull)) {
+        cout << "state without a topology read back differently" << endl;
+        passed = false;
+    }
+
+    remove(flatPath.c_str());
+
+    // published states are attached to like the file they came from
+    const string name = "/hte-storage-test";
+    StateView::publish(path, name);
+    State attached = State::fromSharedMemory(name, LoadMode::FULL);
+    StateView::unpublish(name);
+
+    if (!SameState(state, attached)) {
+        cout << "published state read back differently" << endl;
+        passed = false;
+    }
+
+    std::ifstream ifs(path, ios::binary);
+    string bytes((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+
+    // sections pointing past the rings, precincts or nodes are rejected
+    for (StateSection id : {StateSection::RING_STARTS, StateSection::ARC_PRECINCTS, StateSection::NODE_IDS,
+                            StateSection::NODE_EDGES, StateSection::EDGES}) {
+        std::ofstream(path, ios::binary | ios::trunc) << DamageSection(bytes, id, 1 << 20);
+
+        try {
+            State::fromFile(path);
+            cout << "damaged section " << static_cast<int>(id) << " was read" << endl;
+            passed = false;
+        }
+        catch (Exceptions::StateFileInvalid&) {}
+    }
+
+    // and node ids used twice
+    std::ofstream(path, ios::binary | ios::trunc) << DamageSection(bytes, StateSection::NODE_IDS, 1);
+
+    try {
+        State::fromFile(path);
+        cout << "repeated node ids were read" << endl;
+        passed = false;
+    }
+    catch (Exceptions::StateFileInvalid&) {}
+
+    // mapping checks that the id offsets end where the ids do
+    std::ofstream(path, ios::binary | ios::trunc) << DamageSection(bytes, StateSection::PRECINCT_IDS, 1 << 20);
+
+    try {
+        StateView view(path);
+        cout << "damaged precinct ids were mapped" << endl;
+        passed = false;
+    }
+    catch (Exceptions::StateFileInvalid&) {}
+
+    // truncated files are rejected rather than read
+    std::ofstream(path, ios::binary | ios::trunc).write(bytes.data(), bytes.size() / 2);
+
+    try {
+        State::fromFile(path);
+        cout << "truncated file was read" << endl;
+        passed = false;
+    }
+    catch (Exceptions::StateFileInvalid&) {}
+
+    try {
+        state.toFile("missing/directory/" + path);
+        cout << "failed write didn't throw" << endl;
+        passed = false;
+    }
+    catch (Exceptions::FileNotWritten&) {}
+
+    remove(path.c_str());
+    if (!passed) return 1;
+    cout << "All tests passed!" << endl;
+    return 0;
+}